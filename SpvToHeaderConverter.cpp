@@ -11,6 +11,23 @@
 #include <deque>
 #include <optional>
 #include <cstring>
+#include <cstdint>
+#include <span>
+#include <algorithm>
+#include <string_view>
+#include <cerrno>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <bit>
+#include <random>
+#include <functional>
+#include <atomic>
+#include <unordered_map>
+#include <unordered_set>
+#include <numeric>
+#include <cstdlib>
 
 #include "Headers/spdlog/spdlog/spdlog.h"
 #include "Headers/spdlog/spdlog/sinks/stdout_color_sinks.h"
@@ -22,6 +39,10 @@
 #include <unistd.h>
 #include <spawn.h>
 #include <sys/wait.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 extern char** environ;
 #endif
@@ -43,10 +64,29 @@ extern char** environ;
 
 #endif
 
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+
+#define SPV_SIMD_X86
+#include <immintrin.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define _TARGET_SSSE3
+#else
+#define _TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+
+#endif
+
 constexpr std::array<const char*, 13> shadertypes =
     { ".vert", ".frag", ".comp", ".tesc", ".tese", ".rgen", ".rchit",
     ".rahit", ".rmiss", ".rint", ".rcall", ".mesh", ".task" };
 
+// Names of stages of shadertypes for generated code
+constexpr std::array<const char*, 13> shaderstages =
+    { "vertex", "fragment", "compute", "tessellation_control", "tessellation_evaluation", "raygen", "closest_hit",
+    "any_hit", "miss", "intersection", "callable", "mesh", "task" };
+
 class ConfigParser final {
 public:
     explicit ConfigParser() {
@@ -100,6 +140,18 @@ public:
         return m_save_module_path;
     }
 
+    _ALWAYS_INLINE std::optional<std::filesystem::path> GetCachePath() const noexcept {
+        return m_cache_path;
+    }
+
+    _ALWAYS_INLINE std::optional<std::filesystem::path> GetCacheMaxSize() const noexcept {
+        return m_cache_max_size;
+    }
+
+    _ALWAYS_INLINE std::optional<std::filesystem::path> GetCxxPath() const noexcept {
+        return m_cxx_path;
+    }
+
 private:
     template<typename T>
         requires requires {
@@ -137,8 +189,12 @@ private:
 
     std::optional<std::filesystem::path> m_glslc_path;
     std::optional<std::filesystem::path> m_save_module_path;
-    const std::array<std::pair<const char*, std::reference_wrapper<std::optional<std::filesystem::path>>>, 2> paircommandpathrefs
-    { { {"glslc_path", m_glslc_path}, {"save_module_path",  m_save_module_path} } };
+    std::optional<std::filesystem::path> m_cache_path;
+    std::optional<std::filesystem::path> m_cache_max_size;
+    std::optional<std::filesystem::path> m_cxx_path;
+    const std::array<std::pair<const char*, std::reference_wrapper<std::optional<std::filesystem::path>>>, 5> paircommandpathrefs
+    { { {"glslc_path", m_glslc_path}, {"save_module_path",  m_save_module_path},
+        {"cache_path", m_cache_path}, {"cache_max_size", m_cache_max_size}, {"cxx_path", m_cxx_path} } };
 };
 
 
@@ -176,6 +232,50 @@ public:
         return m_tocompilelist;
     }
 
+    _ALWAYS_INLINE std::optional<bool> GetIsIncremental() const noexcept {
+        return m_isincremental;
+    }
+
+    _ALWAYS_INLINE std::optional<bool> GetIsReproducible() const noexcept {
+        return m_isreproducible;
+    }
+
+    _ALWAYS_INLINE std::optional<bool> GetIsPartitions() const noexcept {
+        return m_ispartitions;
+    }
+
+    _ALWAYS_INLINE std::optional<bool> GetIsHeader() const noexcept {
+        return m_isheader;
+    }
+
+    _ALWAYS_INLINE std::optional<std::deque<S>> GetJobs() const noexcept {
+        return m_jobs;
+    }
+
+    _ALWAYS_INLINE std::optional<std::deque<S>> GetShards() const noexcept {
+        return m_shards;
+    }
+
+    _ALWAYS_INLINE std::optional<std::deque<S>> GetShardBytes() const noexcept {
+        return m_shard_bytes;
+    }
+
+    _ALWAYS_INLINE std::optional<std::deque<S>> GetDepfile() const noexcept {
+        return m_depfile;
+    }
+
+    _ALWAYS_INLINE std::optional<std::deque<S>> GetFormat() const noexcept {
+        return m_format;
+    }
+
+    _ALWAYS_INLINE std::optional<std::deque<S>> GetStrip() const noexcept {
+        return m_strip;
+    }
+
+    _ALWAYS_INLINE std::optional<std::deque<S>> GetDedup() const noexcept {
+        return m_dedup;
+    }
+
 private:
     template<typename T>
         requires requires {
@@ -260,15 +360,50 @@ private:
     }
 
     std::optional<bool> m_iscompileall;
+    std::optional<bool> m_isincremental;
+    std::optional<bool> m_isreproducible;
+    std::optional<bool> m_ispartitions;
+    std::optional<bool> m_isheader;
     std::optional<std::deque<S>> m_tocompilelist;
+    std::optional<std::deque<S>> m_jobs;
+    std::optional<std::deque<S>> m_depfile;
+    std::optional<std::deque<S>> m_format;
+    std::optional<std::deque<S>> m_shards;
+    std::optional<std::deque<S>> m_shard_bytes;
+    std::optional<std::deque<S>> m_strip;
+    std::optional<std::deque<S>> m_dedup;
     const std::array<std::pair<const char*,
-        std::reference_wrapper<std::optional<bool>>>, 1> paircommandboolrefs
-    { { {"-compile_all", m_iscompileall} } };
+        std::reference_wrapper<std::optional<bool>>>, 5> paircommandboolrefs
+    { { {"-compile_all", m_iscompileall}, {"-incremental", m_isincremental},
+        {"-reproducible", m_isreproducible}, {"-partitions", m_ispartitions}, {"-header", m_isheader} } };
     const std::array<std::pair<const char*,
-        std::reference_wrapper<std::optional<std::deque<S>>>>, 1> paircommandstringrefs
-    { { {"-compile_files", m_tocompilelist} } };
+        std::reference_wrapper<std::optional<std::deque<S>>>>, 8> paircommandstringrefs
+    { { {"-compile_files", m_tocompilelist}, {"-jobs", m_jobs}, {"-MF", m_depfile},
+        {"-format", m_format}, {"-shards", m_shards}, {"-shard_bytes", m_shard_bytes}, {"-strip", m_strip},
+        {"-dedup", m_dedup} } };
 };
 
+template<typename S>
+    requires requires {
+    std::is_same<S, std::string>::value || std::is_same<S, std::wstring>::value;
+}
+[[nodiscard]] unsigned long long ParseCountArgument(const std::deque<S>& values, const char* command) {
+    std::size_t pos{ 0 };
+    unsigned long long count{ 0 };
+    try {
+        if (values.size() == 1) {
+            count = std::stoull(values.front(), &pos);
+        }
+    }
+    catch (const std::logic_error&) {
+        pos = 0;
+    }
+    if (pos == 0 || pos != values.front().size() || count == 0) {
+        throw std::runtime_error(std::string(command) + " must be positive number");
+    }
+    return count;
+}
+
 template<typename T>
     requires requires {
     std::is_same<T, std::string>::value || std::is_same<T, std::wstring>::value;
@@ -295,211 +430,3854 @@ void CreateListWithShaderSources(std::deque<T>& list) {
 }
 
 
+constexpr std::uint64_t xxh_prime1 = 0x9E3779B185EBCA87ull;
+constexpr std::uint64_t xxh_prime2 = 0xC2B2AE3D27D4EB4Full;
+constexpr std::uint64_t xxh_prime3 = 0x165667B19E3779F9ull;
+constexpr std::uint64_t xxh_prime4 = 0x85EBCA77C2B2AE63ull;
+constexpr std::uint64_t xxh_prime5 = 0x27D4EB2F165667C5ull;
+
+_ALWAYS_INLINE std::uint64_t XxhRound(std::uint64_t acc, const std::uint64_t input) noexcept {
+    acc += input * xxh_prime2;
+    return std::rotl(acc, 31) * xxh_prime1;
+}
+
+_ALWAYS_INLINE std::uint64_t XxhMerge(const std::uint64_t acc, const std::uint64_t value) noexcept {
+    return (acc ^ XxhRound(0, value)) * xxh_prime1 + xxh_prime4;
+}
+
+template<typename T>
+_ALWAYS_INLINE T LoadLittle(const std::byte* data) noexcept {
+    T value;
+    std::memcpy(&value, data, sizeof value);
+    if constexpr (std::endian::native == std::endian::big) {
+        T swapped{ 0 };
+        for (std::size_t i = 0; i < sizeof value; i++) {
+            swapped = (swapped << 8) | ((value >> (8 * i)) & 0xFF);
+        }
+        value = swapped;
+    }
+    return value;
+}
+
+// XXH64 hash of data
+[[nodiscard]] std::uint64_t Hash64(const std::span<const std::byte> data, const std::uint64_t seed = 0) noexcept {
+    const std::byte* ptr = data.data();
+    const std::byte* const end = ptr + data.size();
+    std::uint64_t hash;
+    if (data.size() >= 32) {
+        std::uint64_t v1 = seed + xxh_prime1 + xxh_prime2;
+        std::uint64_t v2 = seed + xxh_prime2;
+        std::uint64_t v3 = seed;
+        std::uint64_t v4 = seed - xxh_prime1;
+        for (; end - ptr >= 32; ptr += 32) {
+            v1 = XxhRound(v1, LoadLittle<std::uint64_t>(ptr));
+            v2 = XxhRound(v2, LoadLittle<std::uint64_t>(ptr + 8));
+            v3 = XxhRound(v3, LoadLittle<std::uint64_t>(ptr + 16));
+            v4 = XxhRound(v4, LoadLittle<std::uint64_t>(ptr + 24));
+        }
+        hash = std::rotl(v1, 1) + std::rotl(v2, 7) + std::rotl(v3, 12) + std::rotl(v4, 18);
+        hash = XxhMerge(hash, v1);
+        hash = XxhMerge(hash, v2);
+        hash = XxhMerge(hash, v3);
+        hash = XxhMerge(hash, v4);
+    }
+    else {
+        hash = seed + xxh_prime5;
+    }
+    hash += data.size();
+    for (; end - ptr >= 8; ptr += 8) {
+        hash ^= XxhRound(0, LoadLittle<std::uint64_t>(ptr));
+        hash = std::rotl(hash, 27) * xxh_prime1 + xxh_prime4;
+    }
+    if (end - ptr >= 4) {
+        hash ^= LoadLittle<std::uint32_t>(ptr) * xxh_prime1;
+        hash = std::rotl(hash, 23) * xxh_prime2 + xxh_prime3;
+        ptr += 4;
+    }
+    for (; ptr != end; ptr++) {
+        hash ^= static_cast<std::uint8_t>(*ptr) * xxh_prime5;
+        hash = std::rotl(hash, 11) * xxh_prime1;
+    }
+    hash ^= hash >> 33;
+    hash *= xxh_prime2;
+    hash ^= hash >> 29;
+    hash *= xxh_prime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+[[nodiscard]] std::string HashToHex(const std::uint64_t hash) {
+    std::string hex(16, '0');
+    for (std::size_t i = 0; i < hex.size(); i++) {
+        hex[i] = "0123456789abcdef"[(hash >> (60 - 4 * i)) & 0xF];
+    }
+    return hex;
+}
+
+// Parses size with optional K, M or G suffix
+template<typename S>
+    requires requires {
+    std::is_same<S, std::string>::value || std::is_same<S, std::wstring>::value;
+}
+[[nodiscard]] std::uintmax_t ParseByteSize(const S& value, const char* command) {
+    std::size_t pos{ 0 };
+    std::uintmax_t size{ 0 };
+    try {
+        size = std::stoull(value, &pos);
+    }
+    catch (const std::logic_error&) {
+        pos = 0;
+    }
+    if (pos != 0 && pos + 1 == value.size()) {
+        switch (value.back()) {
+        case 'K': case 'k': size <<= 10; pos++; break;
+        case 'M': case 'm': size <<= 20; pos++; break;
+        case 'G': case 'g': size <<= 30; pos++; break;
+        default: break;
+        }
+    }
+    if (pos == 0 || pos != value.size() || size == 0) {
+        throw std::runtime_error(std::string(command) + " must be positive size with optional K, M or G suffix");
+    }
+    return size;
+}
+
+[[nodiscard]] std::optional<std::string> ReadWholeFile(const std::filesystem::path& filepath) {
+    std::ifstream file{ filepath, std::ios::in | std::ios::ate | std::ios::binary };
+    if (!file) {
+        return std::nullopt;
+    }
+    std::string content(static_cast<std::size_t>(file.tellg()), '\0');
+    file.seekg(0, std::ios::beg);
+    if (!file.read(content.data(), content.size())) {
+        return std::nullopt;
+    }
+    return content;
+}
+
+// Identity of compiler binary for cache keys: its path, size and modification time
+[[nodiscard]] std::string CompilerIdentity(const std::filesystem::path& binary) {
+    std::string identity = binary.string();
+    std::error_code ec;
+    const std::uintmax_t size = std::filesystem::file_size(binary, ec);
+    if (!ec) {
+        const auto mtime = std::filesystem::last_write_time(binary, ec);
+        identity += ":" + std::to_string(size) + ":" + std::to_string(mtime.time_since_epoch().count());
+    }
+    return identity;
+}
+
+// On-disk cache of glslc outputs keyed by hash of shader source with all
+// its includes, compiler identity and flags. Entries are published with
+// rename, so several converters can share one cache directory
+class ShaderCompileCache final {
+public:
+    static constexpr std::uintmax_t default_max_size = 1024ull * 1024 * 1024;
+
+    explicit ShaderCompileCache(const std::filesystem::path& cachedir, const std::uintmax_t maxsize)
+        : m_cachedir(cachedir), m_maxsize(maxsize) {
+        std::filesystem::create_directories(m_cachedir);
+    }
+
+    ShaderCompileCache(const ShaderCompileCache&) = delete;
+    ShaderCompileCache(const ShaderCompileCache&&) = delete;
+    ShaderCompileCache& operator=(const ShaderCompileCache&) = delete;
+    ShaderCompileCache& operator=(const ShaderCompileCache&&) = delete;
+
+    // Returns nullopt if shader source can't be read
+    [[nodiscard]] std::optional<std::string> MakeKey(const std::filesystem::path& source,
+                                                     const std::string& compilerandflags) const {
+        std::string material = compilerandflags;
+        material += '\0';
+        std::vector<std::filesystem::path> visited;
+        if (!AppendIncludeClosure(source, material, visited)) {
+            return std::nullopt;
+        }
+        const std::span<const std::byte> bytes = std::as_bytes(std::span(material));
+        return HashToHex(Hash64(bytes, 0)) + HashToHex(Hash64(bytes, xxh_prime3));
+    }
+
+    // Copies cached .spv (and its .d dependency file if it was cached) to output, returns false on miss
+    bool Fetch(const std::string& key, const std::filesystem::path& output) {
+        const std::filesystem::path entry = EntryPath(key);
+        std::error_code ec;
+        std::filesystem::copy_file(entry, output, std::filesystem::copy_options::overwrite_existing, ec);
+        if (!ec && std::filesystem::exists(DepfilePath(entry), ec)) {
+            std::filesystem::copy_file(DepfilePath(entry), DepfilePath(output),
+                                       std::filesystem::copy_options::overwrite_existing, ec);
+        }
+        if (ec) {
+            m_misses++;
+            return false;
+        }
+        std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), ec);
+        m_hits++;
+        return true;
+    }
+
+    void Store(const std::string& key, const std::filesystem::path& output) {
+        const std::filesystem::path entry = EntryPath(key);
+        const std::filesystem::path temp = entry.string() + ".tmp" + HashToHex(m_random());
+        std::error_code ec;
+        std::filesystem::create_directories(entry.parent_path(), ec);
+        if (!ec && std::filesystem::exists(DepfilePath(output), ec)) {
+            const std::filesystem::path tempdeps = DepfilePath(temp);
+            std::filesystem::copy_file(DepfilePath(output), tempdeps,
+                                       std::filesystem::copy_options::overwrite_existing, ec);
+            if (!ec) {
+                std::filesystem::rename(tempdeps, DepfilePath(entry), ec);
+            }
+        }
+        if (!ec) {
+            std::filesystem::copy_file(output, temp, std::filesystem::copy_options::overwrite_existing, ec);
+        }
+        if (!ec) {
+            std::filesystem::rename(temp, entry, ec);
+        }
+        if (ec) {
+            spdlog::warn("Unable to store {0} in compile cache: {1}", output.string(), ec.message());
+            std::filesystem::remove(temp, ec);
+        }
+    }
+
+    // Removes least recently used entries while cache is bigger than limit
+    void Trim() {
+        struct Entry {
+            std::filesystem::file_time_type mtime;
+            std::uintmax_t size;
+            std::filesystem::path path;
+        };
+        std::vector<Entry> entries;
+        std::uintmax_t total{ 0 };
+        std::error_code ec;
+        for (auto it = std::filesystem::recursive_directory_iterator(m_cachedir, ec);
+             !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+            std::error_code entryec;
+            if (it->is_regular_file(entryec) && it->path().extension() == ".spv") {
+                const std::uintmax_t size = it->file_size(entryec);
+                const auto mtime = it->last_write_time(entryec);
+                if (!entryec) {
+                    entries.emplace_back(Entry{ mtime, size, it->path() });
+                    total += size;
+                }
+            }
+        }
+        if (total <= m_maxsize) {
+            return;
+        }
+        std::sort(entries.begin(), entries.end(),
+                  [](const Entry& a, const Entry& b) { return a.mtime < b.mtime; });
+        const std::uintmax_t target = m_maxsize / 10 * 9;
+        std::size_t removed{ 0 };
+        for (const Entry& entry : entries) {
+            if (total <= target) {
+                break;
+            }
+            if (std::filesystem::remove(entry.path, ec)) {
+                removed++;
+            }
+            std::filesystem::remove(DepfilePath(entry.path), ec);
+            total -= entry.size;
+        }
+        spdlog::info("Compile cache trimmed, {0} entries removed", removed);
+    }
+
+    _ALWAYS_INLINE std::size_t GetHits() const noexcept {
+        return m_hits;
+    }
+
+    _ALWAYS_INLINE std::size_t GetMisses() const noexcept {
+        return m_misses;
+    }
+
+private:
+    [[nodiscard]] static std::filesystem::path DepfilePath(const std::filesystem::path& output) {
+        std::filesystem::path depfile = output;
+        depfile += ".d";
+        return depfile;
+    }
+
+    [[nodiscard]] std::filesystem::path EntryPath(const std::string& key) const {
+        return m_cachedir / key.substr(0, 2) / (key.substr(2) + ".spv");
+    }
+
+    // Appends file content and contents of files included with #include
+    bool AppendIncludeClosure(const std::filesystem::path& file, std::string& material,
+                              std::vector<std::filesystem::path>& visited) const {
+        const std::filesystem::path normal = file.lexically_normal();
+        if (std::find(visited.begin(), visited.end(), normal) != visited.end()) {
+            return true;
+        }
+        visited.emplace_back(normal);
+        const std::optional<std::string> content = ReadWholeFile(normal);
+        if (!content.has_value()) {
+            return false;
+        }
+        material += normal.filename().string();
+        material += '\0';
+        material += std::to_string(content->size());
+        material += '\0';
+        material += content.value();
+
+        std::istringstream lines(content.value());
+        for (std::string line; std::getline(lines, line); ) {
+            std::size_t pos = line.find_first_not_of(" \t");
+            if (pos == std::string::npos || line[pos] != '#') {
+                continue;
+            }
+            pos = line.find_first_not_of(" \t", pos + 1);
+            if (pos == std::string::npos || line.compare(pos, 7, "include") != 0) {
+                continue;
+            }
+            pos = line.find_first_of("\"<", pos + 7);
+            if (pos == std::string::npos) {
+                continue;
+            }
+            const std::size_t close = line.find(line[pos] == '"' ? '"' : '>', pos + 1);
+            if (close == std::string::npos) {
+                continue;
+            }
+            const std::string included = line.substr(pos + 1, close - pos - 1);
+            if (!AppendIncludeClosure(normal.parent_path() / included, material, visited)) {
+                material += "missing:" + included;
+                material += '\0';
+            }
+        }
+        return true;
+    }
+
+    std::filesystem::path m_cachedir;
+    std::uintmax_t m_maxsize;
+    std::size_t m_hits{ 0 };
+    std::size_t m_misses{ 0 };
+    std::random_device m_random;
+};
+
+// glslc -c places output to current directory with .spv added to source file name
+[[nodiscard]] std::filesystem::path GlslcOutputPath(const std::filesystem::path& source) {
+    std::filesystem::path output = source.filename();
+    output += ".spv";
+    return output;
+}
+
 #if defined(_WIN32) || defined(WIN32)
+// Runs one glslc process per shader, up to jobs processes at once.
+// After first failure no new processes are started and running ones are terminated.
+// Shaders found in compile cache are not compiled. With depfiles glslc writes
+// dependencies of every shader to its output file name with .d added
 bool RunGlslcProcess(const std::optional<std::filesystem::path>& glslc_path,
                      const std::optional<bool>& iscompileall,
-                     const std::optional<std::deque<std::wstring>>& tocompilelist) noexcept {
-    std::wstring commandline_str{ glslc_path.has_value() ? glslc_path.value().wstring()
-                                                + L"glslc.exe -c -O" : L"glslc.exe -c -O" };
+                     const std::optional<std::deque<std::wstring>>& tocompilelist,
+                     const unsigned jobs,
+                     const bool depfiles,
+                     std::optional<ShaderCompileCache>& cache) noexcept {
+    const std::wstring commandline_base{ (glslc_path.has_value() ? glslc_path.value().wstring()
+                                                + L"glslc.exe -c -O" : L"glslc.exe -c -O") +
+                                                std::wstring(depfiles ? L" -MD" : L"") };
     std::deque<std::wstring> listofshaders;
     const std::wstring basepathstr{ std::filesystem::current_path().wstring()};    
     if (iscompileall.has_value()) {
         CreateListWithShaderSources(listofshaders);
-        for (auto const& shaderstr : listofshaders) {
-            commandline_str += glslc_path.has_value() ? L" " +
-                basepathstr + L"\\" + shaderstr : L" " + shaderstr; 
-        }
     }
     else if (tocompilelist.has_value()) {
-        for (auto const& shaderstr : tocompilelist.value()) {
-            commandline_str += glslc_path.has_value() ? L" " +
-                basepathstr + L"\\" + shaderstr : L" " + shaderstr;
-        }
+        listofshaders = tocompilelist.value();
     }
     else {
         spdlog::error("No coommand for glslc operation");
         return false;
     }
 
-    STARTUPINFOW si{
-        .cb = sizeof(si)
+    const std::size_t maxrunning = std::clamp<std::size_t>(jobs, 1, MAXIMUM_WAIT_OBJECTS);
+    const std::filesystem::path glslc_binary = glslc_path.has_value() ?
+        glslc_path.value() / L"glslc.exe" : std::filesystem::path(L"glslc.exe");
+    const std::string cachekeyprefix = CompilerIdentity(glslc_binary) + (depfiles ? " -c -O -MD" : " -c -O");
+    std::vector<HANDLE> running;
+    std::vector<std::size_t> runningshaders;
+    std::vector<std::optional<std::string>> runningkeys;
+    std::size_t next{ 0 };
+    std::size_t failures{ 0 };
+    std::size_t cached{ 0 };
+    bool cancelled{ false };
+
+    const auto cancel = [&]() {
+        if (!cancelled) {
+            cancelled = true;
+            for (const HANDLE process : running) {
+                TerminateProcess(process, 1);
+            }
+        }
     };
-    PROCESS_INFORMATION pi{};    
 
-    if (!CreateProcessW(nullptr, const_cast<wchar_t*>(commandline_str.c_str()),
-                        nullptr, nullptr, false, 0, nullptr, nullptr, &si, &pi)) {
-        spdlog::critical("CreateProcess failed: {0}", GetLastError());
-        return false;
-    }
+    while (next < listofshaders.size() || !running.empty()) {
+        while (!cancelled && running.size() < maxrunning && next < listofshaders.size()) {
+            const std::wstring& shaderstr = listofshaders[next];
+            std::optional<std::string> cachekey;
+            if (cache.has_value()) {
+                cachekey = cache->MakeKey(basepathstr + L"\\" + shaderstr, cachekeyprefix);
+                if (cachekey.has_value() && cache->Fetch(cachekey.value(), GlslcOutputPath(shaderstr))) {
+                    cached++;
+                    next++;
+                    continue;
+                }
+            }
+            std::wstring commandline_str = commandline_base + (glslc_path.has_value() ?
+                L" " + basepathstr + L"\\" + shaderstr : L" " + shaderstr);
+            STARTUPINFOW si{
+                .cb = sizeof(si)
+            };
+            PROCESS_INFORMATION pi{};
+            if (!CreateProcessW(nullptr, commandline_str.data(),
+                                nullptr, nullptr, false, 0, nullptr, nullptr, &si, &pi)) {
+                spdlog::critical("CreateProcess failed: {0}", GetLastError());
+                failures++;
+                cancel();
+                break;
+            }
+            CloseHandle(pi.hThread);
+            running.emplace_back(pi.hProcess);
+            runningshaders.emplace_back(next);
+            runningkeys.emplace_back(std::move(cachekey));
+            next++;
+        }
+        if (running.empty()) {
+            break;
+        }
 
-    const DWORD status = WaitForSingleObject(pi.hProcess, INFINITE);
-    bool result{ true };
-    switch (status) {
-    case WAIT_ABANDONED: 
-        spdlog::error("GLSLC exited with status: WAIT_ABANDONED");
-        result = false;
-        break;
-    case WAIT_OBJECT_0:
-        spdlog::info("GLSLC exited with status: WAIT_OBJECT_0");
-        result = true;
-        break;
-    case WAIT_TIMEOUT:
-        spdlog::error("GLSLC exited with status: WAIT_TIMEOUT");
-        result = false;
-        break;
-    case WAIT_FAILED:
-        spdlog::error("GLSLC exited with status: WAIT_FAILED");
-        result = false;
-        break;
-    default:        
-        spdlog::error("GLSLC exited with status: unknown type of status");
-        result = false;
-        break;
-    }  
+        const DWORD status = WaitForMultipleObjects(static_cast<DWORD>(running.size()),
+                                                    running.data(), false, INFINITE);
+        if (status < WAIT_OBJECT_0 || status >= WAIT_OBJECT_0 + running.size()) {
+            spdlog::error("GLSLC wait failed with status: {0}", GetLastError());
+            failures++;
+            cancel();
+            for (const HANDLE process : running) {
+                CloseHandle(process);
+            }
+            break;
+        }
+        const std::size_t finished = status - WAIT_OBJECT_0;
+        DWORD exitcode{ 1 };
+        GetExitCodeProcess(running[finished], &exitcode);
+        const std::wstring& finishedshader = listofshaders[runningshaders[finished]];
+        if (exitcode != 0 && !cancelled) {
+            spdlog::error("GLSLC failed on {0} with exit code {1}",
+                          std::string(finishedshader.begin(), finishedshader.end()), exitcode);
+            failures++;
+            cancel();
+        }
+        else if (exitcode == 0 && runningkeys[finished].has_value()) {
+            cache->Store(runningkeys[finished].value(), GlslcOutputPath(finishedshader));
+        }
+        CloseHandle(running[finished]);
+        running.erase(running.begin() + finished);
+        runningshaders.erase(runningshaders.begin() + finished);
+        runningkeys.erase(runningkeys.begin() + finished);
+    }
 
-    CloseHandle(pi.hProcess);
-    CloseHandle(pi.hThread);
-    return result;
+    if (failures != 0) {
+        spdlog::error("GLSLC failed on {0} shaders, {1} of {2} shaders were not started",
+                      failures, listofshaders.size() - next, listofshaders.size());
+        return false;
+    }
+    if (cache.has_value()) {
+        spdlog::info("Compile cache: {0} hits, {1} misses", cache->GetHits(), cache->GetMisses());
+        cache->Trim();
+    }
+    spdlog::info("GLSLC compiled {0} shaders with {1} jobs, {2} shaders are taken from compile cache",
+                 listofshaders.size() - cached, maxrunning, cached);
+    return true;
 }
 #else
+// Runs one glslc process per shader, up to jobs processes at once.
+// After first failure no new processes are started and running ones are terminated.
+// Shaders found in compile cache are not compiled. With depfiles glslc writes
+// dependencies of every shader to its output file name with .d added
 bool RunGlslcProcess(const std::optional<std::filesystem::path>& glslc_path,
                      const std::optional<bool>& iscompileall,
-                     const std::optional<std::deque<std::string>>& tocompilelist) noexcept {
-
-    pid_t pid;
+                     const std::optional<std::deque<std::string>>& tocompilelist,
+                     const unsigned jobs,
+                     const bool depfiles,
+                     std::optional<ShaderCompileCache>& cache) noexcept {
     std::deque<std::string> listofshaders;
     const std::string gl_path_param = glslc_path.has_value() ?
         glslc_path.value().string() : "/bin/glslc";
     const char* c_param{ "-c" };
-    const char* o_param{ "-0" };
-    std::vector<char*> vec_argv{
-        const_cast<char*>(gl_path_param.c_str()),
-        const_cast<char*>(c_param),
-        const_cast<char*>(o_param),
-    };    
+    const char* o_param{ "-O" };
+    const char* md_param{ "-MD" };
 
     if (iscompileall.has_value()) {
         CreateListWithShaderSources(listofshaders);
-        for (auto const& shaderstr : listofshaders) {
-            vec_argv.emplace_back(const_cast<char*>(shaderstr.c_str()));
-        }
     }
     else if (tocompilelist.has_value()) {
-        for (auto const& shaderstr : tocompilelist.value()) {
-            vec_argv.emplace_back(const_cast<char*>(shaderstr.c_str()));
-        }
+        listofshaders = tocompilelist.value();
     }
     else {
         spdlog::error("No coommand for glslc operation");
         return false;
     }
-    vec_argv.emplace_back(nullptr);
-    
+
+    struct RunningGlslc {
+        pid_t pid;
+        std::size_t shader;
+        std::optional<std::string> cachekey;
+    };
+
+    const std::size_t maxrunning = std::max(jobs, 1u);
+    const std::string cachekeyprefix = CompilerIdentity(gl_path_param) + " " + c_param + " " + o_param +
+        (depfiles ? std::string(" ") + md_param : std::string());
+    std::vector<RunningGlslc> running;
+    std::size_t next{ 0 };
+    std::size_t failures{ 0 };
+    std::size_t cached{ 0 };
+    bool cancelled{ false };
+
+    const auto cancel = [&]() {
+        if (!cancelled) {
+            cancelled = true;
+            for (const RunningGlslc& process : running) {
+                kill(process.pid, SIGTERM);
+            }
+        }
+    };
+
     fflush(nullptr);
-    bool result{ true };
-    int status = posix_spawn(&pid, gl_path_param.c_str(), nullptr, nullptr, vec_argv.data(), environ);
-    if (status == 0) {
-        fflush(nullptr);
-        if (waitpid(pid, &status, 0) != -1) {
-            spdlog::info("GLSLC exited with status: {0}", strerror(status));
-            result = true;
+    while (next < listofshaders.size() || !running.empty()) {
+        while (!cancelled && running.size() < maxrunning && next < listofshaders.size()) {
+            std::optional<std::string> cachekey;
+            if (cache.has_value()) {
+                cachekey = cache->MakeKey(listofshaders[next], cachekeyprefix);
+                if (cachekey.has_value() && cache->Fetch(cachekey.value(), GlslcOutputPath(listofshaders[next]))) {
+                    cached++;
+                    next++;
+                    continue;
+                }
+            }
+            std::vector<char*> vec_argv{
+                const_cast<char*>(gl_path_param.c_str()),
+                const_cast<char*>(c_param),
+                const_cast<char*>(o_param),
+            };
+            if (depfiles) {
+                vec_argv.emplace_back(const_cast<char*>(md_param));
+            }
+            vec_argv.emplace_back(const_cast<char*>(listofshaders[next].c_str()));
+            vec_argv.emplace_back(nullptr);
+            pid_t pid;
+            const int status = posix_spawn(&pid, gl_path_param.c_str(), nullptr, nullptr, vec_argv.data(), environ);
+            if (status != 0) {
+                spdlog::critical("CreateProcess failed: {0}", strerror(status));
+                failures++;
+                cancel();
+                break;
+            }
+            running.emplace_back(RunningGlslc{ pid, next, std::move(cachekey) });
+            next++;
         }
-        else {
-            perror("waitpid");
-            spdlog::error("GLSLC exited with status: {0}", strerror(status));
-            result = false;
+        if (running.empty()) {
+            break;
+        }
+
+        int status{ 0 };
+        const pid_t pid = waitpid(-1, &status, 0);
+        if (pid == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            spdlog::error("GLSLC wait failed: {0}", strerror(errno));
+            failures++;
+            cancel();
+            break;
+        }
+        const auto finished = std::find_if(running.begin(), running.end(),
+                                           [pid](const RunningGlslc& item) { return item.pid == pid; });
+        if (finished == running.end()) {
+            continue;
+        }
+        if (!cancelled && !(WIFEXITED(status) && WEXITSTATUS(status) == 0)) {
+            if (WIFSIGNALED(status)) {
+                spdlog::error("GLSLC on {0} was killed by signal {1}",
+                              listofshaders[finished->shader], WTERMSIG(status));
+            }
+            else {
+                spdlog::error("GLSLC failed on {0} with exit code {1}",
+                              listofshaders[finished->shader], WEXITSTATUS(status));
+            }
+            failures++;
+            cancel();
+        }
+        else if (WIFEXITED(status) && WEXITSTATUS(status) == 0 && finished->cachekey.has_value()) {
+            cache->Store(finished->cachekey.value(), GlslcOutputPath(listofshaders[finished->shader]));
         }
+        running.erase(finished);
     }
-    else {
-        spdlog::critical("CreateProcess failed: {0}", strerror(status));
+
+    if (failures != 0) {
+        spdlog::error("GLSLC failed on {0} shaders, {1} of {2} shaders were not started",
+                      failures, listofshaders.size() - next, listofshaders.size());
         return false;
     }
-    return result;
+    if (cache.has_value()) {
+        spdlog::info("Compile cache: {0} hits, {1} misses", cache->GetHits(), cache->GetMisses());
+        cache->Trim();
+    }
+    spdlog::info("GLSLC compiled {0} shaders with {1} jobs, {2} shaders are taken from compile cache",
+                 listofshaders.size() - cached, maxrunning, cached);
+    return true;
 }
 #endif
 
-[[nodiscard]] inline std::string convert_correct_string(const std::uint8_t a) noexcept {
-    std::stringstream buf;
-    buf << std::hex << static_cast<unsigned int>(a);
-    const std::string temp = buf.str();
-    const std::size_t len = temp.length();
-    std::string final = "0x";
-    final += (len == 1) ? "0" + temp : temp;
-    return final;
+// Runs process with output discarded and waits for it, gives exit code or nothing if it can't be run
+[[nodiscard]] std::optional<int> RunProcessQuiet(const std::filesystem::path& binary,
+                                                 const std::vector<std::string>& arguments) {
+#if defined(_WIN32) || defined(WIN32)
+    std::wstring commandline = L"\"" + binary.wstring() + L"\"";
+    for (const std::string& argument : arguments) {
+        commandline += L" \"" + std::filesystem::path(argument).wstring() + L"\"";
+    }
+    SECURITY_ATTRIBUTES sa{
+        .nLength = sizeof(sa),
+        .bInheritHandle = true
+    };
+    const HANDLE nul = CreateFileW(L"NUL", GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, &sa,
+                                   OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    STARTUPINFOW si{
+        .cb = sizeof(si),
+        .dwFlags = STARTF_USESTDHANDLES,
+        .hStdInput = GetStdHandle(STD_INPUT_HANDLE),
+        .hStdOutput = nul,
+        .hStdError = nul
+    };
+    PROCESS_INFORMATION pi{};
+    const bool started = CreateProcessW(nullptr, commandline.data(), nullptr, nullptr, true, 0,
+                                        nullptr, nullptr, &si, &pi);
+    if (nul != INVALID_HANDLE_VALUE) {
+        CloseHandle(nul);
+    }
+    if (!started) {
+        return std::nullopt;
+    }
+    CloseHandle(pi.hThread);
+    WaitForSingleObject(pi.hProcess, INFINITE);
+    DWORD exitcode{ 1 };
+    GetExitCodeProcess(pi.hProcess, &exitcode);
+    CloseHandle(pi.hProcess);
+    return static_cast<int>(exitcode);
+#else
+    const std::string binarystr = binary.string();
+    std::vector<char*> vec_argv{ const_cast<char*>(binarystr.c_str()) };
+    for (const std::string& argument : arguments) {
+        vec_argv.emplace_back(const_cast<char*>(argument.c_str()));
+    }
+    vec_argv.emplace_back(nullptr);
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+    pid_t pid;
+    fflush(nullptr);
+    const int status = posix_spawnp(&pid, binarystr.c_str(), &actions, nullptr, vec_argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    if (status != 0) {
+        return std::nullopt;
+    }
+    int waitstatus{ 0 };
+    while (waitpid(pid, &waitstatus, 0) == -1) {
+        if (errno != EINTR) {
+            return std::nullopt;
+        }
+    }
+    return WIFEXITED(waitstatus) ? WEXITSTATUS(waitstatus) : -1;
+#endif
 }
 
-void createModuleFromSpvFiles(const std::optional<std::filesystem::path>& save_module_path) {
-    const std::filesystem::path basepath{ std::filesystem::current_path() };
-
-    std::stringstream finalbuf;
-
-    finalbuf << "export module shader_spv;\n\nimport <array>;\n\n";
-    finalbuf << "namespace OnyWarp\n{\n";
-
-    constexpr int num_in_str = 16;
+// Checks that C++ compiler accepts #embed by compiling small file which embeds itself
+[[nodiscard]] bool IsEmbedSupported(const std::filesystem::path& cxx_path) {
+    std::error_code ec;
+    const std::filesystem::path probepath = std::filesystem::temp_directory_path(ec) /
+        ("spv2headerconv_embed_probe_" + HashToHex(std::random_device{}()) + ".cpp");
+    if (ec) {
+        return false;
+    }
+    {
+        std::ofstream probe{ probepath, std::ios::out | std::ios::binary };
+        probe << "static const unsigned char probe[] = {\n#embed \"" << probepath.filename().string()
+              << "\" limit(4)\n};\nstatic_assert(sizeof(probe) == 4);\n";
+        if (!probe) {
+            return false;
+        }
+    }
+    const std::string compilername = cxx_path.stem().string();
+    const bool msvcstyle = compilername == "cl" || compilername == "clang-cl";
+    const std::optional<int> exitcode = RunProcessQuiet(cxx_path, msvcstyle ?
+        std::vector<std::string>{ "/nologo", "/std:c++latest", "/Zs", probepath.string() } :
+        std::vector<std::string>{ "-std=c++20", "-fsyntax-only", probepath.string() });
+    std::filesystem::remove(probepath, ec);
+    return exitcode.has_value() && exitcode.value() == 0;
+}
 
-    for (auto const& dir_entry : std::filesystem::directory_iterator{ basepath }) {
-        if (dir_entry.is_regular_file()) {
-            std::filesystem::path filepath{ dir_entry };
-            if (filepath.extension() == ".spv") {
-                if (std::ifstream filespv{ filepath, std::ios::in | std::ios::ate | std::ios::binary }) {
-                    std::size_t filesize = filespv.tellg();
-                    filespv.seekg(0, std::ios::beg);
+// Gives read-only view of whole .spv file: big files are memory-mapped,
+// small ones are read with one call into reusable buffer
+class SpvFileReader final {
+public:
+    static constexpr std::size_t mmap_threshold = 256 * 1024;
 
-                    std::string nameofdata = filepath.stem().string();
-                    std::replace(nameofdata.begin(), nameofdata.end(), '.', '_');
+    explicit SpvFileReader() = default;
 
-                    finalbuf << "\texport constinit std::array<const unsigned char, " << filesize << "> "
-                        << nameofdata << "_bytecode\n\t{\n\t\t";
+    ~SpvFileReader() {
+        Release();
+    }
 
-                    std::uint8_t read_symbol;
-                    int cur_num = 0;
+    SpvFileReader(const SpvFileReader&) = delete;
+    SpvFileReader(const SpvFileReader&&) = delete;
+    SpvFileReader& operator=(const SpvFileReader&) = delete;
+    SpvFileReader& operator=(const SpvFileReader&&) = delete;
 
-                    while (filesize != 0) {
-                        filespv.read(reinterpret_cast<char*>(&read_symbol), sizeof read_symbol);
-                        finalbuf << convert_correct_string(read_symbol) << ",";
-                        if (++cur_num == num_in_str) {
-                            finalbuf << "\n\t\t";
-                            cur_num = 0;
-                        }
-                        filesize--;
-                    }
-                }
-                finalbuf << "\n\t};\n";
+    // Returned data is valid until next Open call or reader destruction
+    [[nodiscard]] std::optional<std::span<const std::byte>> Open(const std::filesystem::path& filepath) {
+        Release();
+#if defined(_WIN32) || defined(WIN32)
+        const HANDLE file = CreateFileW(filepath.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                        nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            spdlog::error("Unable to open {0}: {1}", filepath.string(), GetLastError());
+            return std::nullopt;
+        }
+        LARGE_INTEGER largesize{};
+        if (!GetFileSizeEx(file, &largesize)) {
+            spdlog::error("Unable to get size of {0}: {1}", filepath.string(), GetLastError());
+            CloseHandle(file);
+            return std::nullopt;
+        }
+        const std::size_t filesize = static_cast<std::size_t>(largesize.QuadPart);
+        if (filesize >= mmap_threshold) {
+            const HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+            if (mapping) {
+                CloseHandle(mapping);
+            }
+            if (view) {
+                CloseHandle(file);
+                m_mapped = view;
+                m_mapped_size = filesize;
+                return std::span<const std::byte>(static_cast<const std::byte*>(view), filesize);
             }
+            spdlog::warn("Unable to map {0}: {1}, file will be read", filepath.string(), GetLastError());
         }
-    }
-    finalbuf << "}";
-    //std::cout << finalbuf.str();
-#if defined(_MSC_VER)
-    const std::wstring writefilename = save_module_path.has_value() ?
-        save_module_path.value().wstring() + L"shader_spv.ixx" : L"shader_spv.ixx";
+        m_buffer.resize(filesize);
+        std::size_t done{ 0 };
+        while (done < filesize) {
+            DWORD readnow{ 0 };
+            const DWORD toread = static_cast<DWORD>(std::min<std::size_t>(filesize - done, 1u << 30));
+            if (!ReadFile(file, m_buffer.data() + done, toread, &readnow, nullptr) || readnow == 0) {
+                spdlog::error("Unable to read {0}: {1}", filepath.string(), GetLastError());
+                CloseHandle(file);
+                return std::nullopt;
+            }
+            done += readnow;
+        }
+        CloseHandle(file);
+        return std::span<const std::byte>(m_buffer.data(), filesize);
 #else
-    const std::string writefilename = save_module_path.has_value() ?
-        save_module_path.value().string() + "shader_spv.ixx" : "shader_spv.ixx";
-#endif
-    std::ofstream ostrm(writefilename, std::ios::out);
-    try {
-        ostrm.exceptions(ostrm.failbit);
+        const int fd = open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            spdlog::error("Unable to open {0}: {1}", filepath.string(), strerror(errno));
+            return std::nullopt;
+        }
+        struct stat filestat{};
+        if (fstat(fd, &filestat) == -1) {
+            spdlog::error("Unable to get size of {0}: {1}", filepath.string(), strerror(errno));
+            close(fd);
+            return std::nullopt;
+        }
+        const std::size_t filesize = static_cast<std::size_t>(filestat.st_size);
+        if (filesize >= mmap_threshold) {
+            void* view = mmap(nullptr, filesize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (view != MAP_FAILED) {
+                close(fd);
+                madvise(view, filesize, MADV_SEQUENTIAL);
+                m_mapped = view;
+                m_mapped_size = filesize;
+                return std::span<const std::byte>(static_cast<const std::byte*>(view), filesize);
+            }
+            spdlog::warn("Unable to map {0}: {1}, file will be read", filepath.string(), strerror(errno));
+        }
+        m_buffer.resize(filesize);
+        std::size_t done{ 0 };
+        while (done < filesize) {
+            const ssize_t readnow = pread(fd, m_buffer.data() + done, filesize - done, static_cast<off_t>(done));
+            if (readnow == -1 && errno == EINTR) {
+                continue;
+            }
+            if (readnow <= 0) {
+                spdlog::error("Unable to read {0}: {1}", filepath.string(),
+                              readnow == 0 ? "unexpected end of file" : strerror(errno));
+                close(fd);
+                return std::nullopt;
+            }
+            done += static_cast<std::size_t>(readnow);
+        }
+        close(fd);
+        return std::span<const std::byte>(m_buffer.data(), filesize);
+#endif
+    }
+
+    void Close() noexcept {
+        Release();
+    }
+
+private:
+    void Release() noexcept {
+        if (m_mapped) {
+#if defined(_WIN32) || defined(WIN32)
+            UnmapViewOfFile(m_mapped);
+#else
+            munmap(m_mapped, m_mapped_size);
+#endif
+            m_mapped = nullptr;
+            m_mapped_size = 0;
+        }
+    }
+
+    std::vector<std::byte> m_buffer;
+    void* m_mapped{ nullptr };
+    std::size_t m_mapped_size{ 0 };
+};
+
+constexpr std::array<std::array<char, 5>, 256> hex_byte_table = [] {
+    constexpr char digits[] = "0123456789abcdef";
+    std::array<std::array<char, 5>, 256> table{};
+    for (std::size_t i = 0; i < table.size(); i++) {
+        table[i] = { '0', 'x', digits[i >> 4], digits[i & 0xF], ',' };
+    }
+    return table;
+}();
+
+#if defined(SPV_SIMD_X86)
+// For every 16 byte chunk of one 80 chars line: index of hex digit in source register
+// (-1 for constant char) and constant char itself ('0', 'x' or ',')
+constexpr std::array<std::array<std::int8_t, 16>, 5> ssse3_line_shuffle = [] {
+    constexpr std::array<int, 5> base{ 0, 0, 8, 16, 16 };
+    std::array<std::array<std::int8_t, 16>, 5> table{};
+    for (int k = 0; k < 5; k++) {
+        for (int j = 0; j < 16; j++) {
+            const int pos = k * 16 + j;
+            const int rem = pos % 5;
+            table[k][j] = (rem == 2 || rem == 3) ?
+                static_cast<std::int8_t>(2 * (pos / 5) + rem - 2 - base[k]) : std::int8_t{ -1 };
+        }
+    }
+    return table;
+}();
+
+constexpr std::array<std::array<char, 16>, 5> ssse3_line_consts = [] {
+    std::array<std::array<char, 16>, 5> table{};
+    for (int k = 0; k < 5; k++) {
+        for (int j = 0; j < 16; j++) {
+            const int rem = (k * 16 + j) % 5;
+            table[k][j] = rem == 0 ? '0' : rem == 1 ? 'x' : rem == 4 ? ',' : '\0';
+        }
+    }
+    return table;
+}();
+
+_TARGET_SSSE3 void EncodeHexLinesSsse3(const std::byte* data, std::size_t lines, char* out) noexcept {
+    const __m128i digits = _mm_setr_epi8('0', '1', '2', '3', '4', '5', '6', '7',
+                                         '8', '9', 'a', 'b', 'c', 'd', 'e', 'f');
+    const __m128i lowmask = _mm_set1_epi8(0x0F);
+    __m128i shuffles[5];
+    __m128i consts[5];
+    for (std::size_t k = 0; k < 5; k++) {
+        shuffles[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ssse3_line_shuffle[k].data()));
+        consts[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ssse3_line_consts[k].data()));
+    }
+
+    for (; lines != 0; lines--) {
+        const __m128i src = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        const __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(src, 4), lowmask));
+        const __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(src, lowmask));
+        const __m128i first = _mm_unpacklo_epi8(hi, lo);
+        const __m128i second = _mm_unpackhi_epi8(hi, lo);
+        const __m128i middle = _mm_alignr_epi8(second, first, 8);
+        const __m128i sources[5]{ first, first, middle, second, second };
+        for (std::size_t k = 0; k < 5; k++) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + k * 16),
+                _mm_or_si128(_mm_shuffle_epi8(sources[k], shuffles[k]), consts[k]));
+        }
+        std::memcpy(out + 80, "\n\t\t", 3);
+        data += 16;
+        out += 83;
+    }
+}
+
+[[nodiscard]] bool IsSsse3Supported() noexcept {
+#if defined(_MSC_VER)
+    std::array<int, 4> cpuinfo{};
+    __cpuid(cpuinfo.data(), 1);
+    return (cpuinfo[2] & (1 << 9)) != 0;
+#else
+    return __builtin_cpu_supports("ssse3");
+#endif
+}
+#endif
+
+// Encodes bytes to "0xNN," text with 16 bytes in line, the same layout
+// as module had with per-byte formatting
+class HexEncoder final {
+public:
+    static constexpr std::size_t bytes_in_line = 16;
+    static constexpr std::size_t chars_in_byte = 5;
+    static constexpr std::size_t chars_in_line_break = 3;
+    static constexpr std::size_t chars_in_line = bytes_in_line * chars_in_byte + chars_in_line_break;
+
+    explicit HexEncoder() noexcept {
+#if defined(SPV_SIMD_X86)
+        m_use_simd = IsSsse3Supported();
+#endif
+    }
+
+    HexEncoder(const HexEncoder&) = delete;
+    HexEncoder(const HexEncoder&&) = delete;
+    HexEncoder& operator=(const HexEncoder&) = delete;
+    HexEncoder& operator=(const HexEncoder&&) = delete;
+
+    [[nodiscard]] static constexpr std::size_t EncodedSize(const std::size_t bytes) noexcept {
+        return bytes * chars_in_byte + (bytes / bytes_in_line) * chars_in_line_break;
+    }
+
+    _ALWAYS_INLINE bool IsSimdUsed() const noexcept {
+        return m_use_simd;
+    }
+
+    // out must have at least EncodedSize(data.size()) chars, returns number of written chars
+    std::size_t Encode(const std::span<const std::byte> data, char* out) const noexcept {
+        const std::size_t lines = data.size() / bytes_in_line;
+        const std::byte* src = data.data();
+        char* dst = out;
+#if defined(SPV_SIMD_X86)
+        if (m_use_simd) {
+            EncodeHexLinesSsse3(src, lines, dst);
+            src += lines * bytes_in_line;
+            dst += lines * chars_in_line;
+        }
+        else
+#endif
+        {
+            for (std::size_t line = 0; line < lines; line++) {
+                for (std::size_t i = 0; i < bytes_in_line; i++) {
+                    std::memcpy(dst, hex_byte_table[static_cast<std::uint8_t>(*src++)].data(), chars_in_byte);
+                    dst += chars_in_byte;
+                }
+                std::memcpy(dst, "\n\t\t", chars_in_line_break);
+                dst += chars_in_line_break;
+            }
+        }
+        for (const std::byte* end = data.data() + data.size(); src != end; src++) {
+            std::memcpy(dst, hex_byte_table[static_cast<std::uint8_t>(*src)].data(), chars_in_byte);
+            dst += chars_in_byte;
+        }
+        return static_cast<std::size_t>(dst - out);
+    }
+
+    // Appends encoded data to the end of string
+    void Encode(const std::span<const std::byte> data, std::string& out) const {
+        const std::size_t oldsize = out.size();
+        out.resize(oldsize + EncodedSize(data.size()));
+        Encode(data, out.data() + oldsize);
+    }
+
+private:
+    bool m_use_simd{ false };
+};
+
+// Writes module text to file in fixed-size chunks, so memory usage does not
+// depend on size of shaders
+class ModuleWriter final {
+public:
+    static constexpr std::size_t chunk_size = 1024 * 1024;
+
+    explicit ModuleWriter(const std::filesystem::path& filepath) : m_buffer(chunk_size) {
+#if defined(_WIN32) || defined(WIN32)
+        m_file = CreateFileW(filepath.wstring().c_str(), GENERIC_WRITE, 0, nullptr,
+                             CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Unable to create " + filepath.string() +
+                                     " with error " + std::to_string(GetLastError()));
+        }
+#else
+        m_fd = open(filepath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (m_fd == -1) {
+            throw std::runtime_error("Unable to create " + filepath.string() +
+                                     " with error " + strerror(errno));
+        }
+#endif
+    }
+
+    ~ModuleWriter() {
+        CloseFile();
+    }
+
+    ModuleWriter(const ModuleWriter&) = delete;
+    ModuleWriter(const ModuleWriter&&) = delete;
+    ModuleWriter& operator=(const ModuleWriter&) = delete;
+    ModuleWriter& operator=(const ModuleWriter&&) = delete;
+
+    void Write(std::string_view text) {
+        while (!text.empty()) {
+            if (m_used == m_buffer.size()) {
+                Flush();
+            }
+            const std::size_t piece = std::min(text.size(), m_buffer.size() - m_used);
+            std::memcpy(m_buffer.data() + m_used, text.data(), piece);
+            Advance(piece);
+            text.remove_prefix(piece);
+        }
+    }
+
+    // Encodes data straight into the chunk, splitting it only on line boundaries
+    void WriteEncoded(const HexEncoder& encoder, std::span<const std::byte> data) {
+        while (!data.empty()) {
+            const std::size_t lines = (m_buffer.size() - m_used) / HexEncoder::chars_in_line;
+            if (lines == 0) {
+                Flush();
+                continue;
+            }
+            const std::span<const std::byte> piece = data.first(std::min(data.size(),
+                                                                lines * HexEncoder::bytes_in_line));
+            Advance(encoder.Encode(piece, m_buffer.data() + m_used));
+            data = data.subspan(piece.size());
+        }
+    }
+
+    void Close() {
+        Flush();
+        CloseFile();
+    }
+
+    // Overwrites already written bytes at offset, used for headers known only at the end
+    void Rewrite(const std::uint64_t offset, const std::string_view data) {
+        Flush();
+        std::size_t done{ 0 };
+        while (done < data.size()) {
+#if defined(_WIN32) || defined(WIN32)
+            OVERLAPPED overlapped{};
+            overlapped.Offset = static_cast<DWORD>((offset + done) & 0xFFFFFFFF);
+            overlapped.OffsetHigh = static_cast<DWORD>((offset + done) >> 32);
+            DWORD writtennow{ 0 };
+            if (!WriteFile(m_file, data.data() + done, static_cast<DWORD>(data.size() - done),
+                           &writtennow, &overlapped)) {
+                throw std::runtime_error("Unable to write module file with error " +
+                                         std::to_string(GetLastError()));
+            }
+#else
+            const ssize_t writtennow = pwrite(m_fd, data.data() + done, data.size() - done,
+                                              static_cast<off_t>(offset + done));
+            if (writtennow == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("Unable to write module file with error ") +
+                                         strerror(errno));
+            }
+#endif
+            done += static_cast<std::size_t>(writtennow);
+        }
+    }
+
+    _ALWAYS_INLINE std::size_t GetPeakBufferUsage() const noexcept {
+        return m_peak_used;
+    }
+
+    _ALWAYS_INLINE std::size_t GetWrittenSize() const noexcept {
+        return m_written;
+    }
+
+private:
+    _ALWAYS_INLINE void Advance(const std::size_t size) noexcept {
+        m_used += size;
+        m_peak_used = std::max(m_peak_used, m_used);
+    }
+
+    void Flush() {
+        std::size_t done{ 0 };
+        while (done < m_used) {
+#if defined(_WIN32) || defined(WIN32)
+            DWORD writtennow{ 0 };
+            if (!WriteFile(m_file, m_buffer.data() + done, static_cast<DWORD>(m_used - done),
+                           &writtennow, nullptr)) {
+                throw std::runtime_error("Unable to write module file with error " +
+                                         std::to_string(GetLastError()));
+            }
+#else
+            const ssize_t writtennow = write(m_fd, m_buffer.data() + done, m_used - done);
+            if (writtennow == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(std::string("Unable to write module file with error ") +
+                                         strerror(errno));
+            }
+#endif
+            done += static_cast<std::size_t>(writtennow);
+        }
+        m_written += m_used;
+        m_used = 0;
+    }
+
+    void CloseFile() noexcept {
+#if defined(_WIN32) || defined(WIN32)
+        if (m_file != INVALID_HANDLE_VALUE) {
+            CloseHandle(m_file);
+            m_file = INVALID_HANDLE_VALUE;
+        }
+#else
+        if (m_fd != -1) {
+            close(m_fd);
+            m_fd = -1;
+        }
+#endif
+    }
+
+    std::vector<char> m_buffer;
+    std::size_t m_used{ 0 };
+    std::size_t m_peak_used{ 0 };
+    std::size_t m_written{ 0 };
+#if defined(_WIN32) || defined(WIN32)
+    HANDLE m_file{ INVALID_HANDLE_VALUE };
+#else
+    int m_fd{ -1 };
+#endif
+};
+
+// Path is converted as UTF-8, so names don't depend on code page of host
+[[nodiscard]] std::string Utf8PathString(const std::filesystem::path& filepath) {
+    const std::u8string u8str = filepath.u8string();
+    return std::string(reinterpret_cast<const char*>(u8str.data()), u8str.size());
+}
+
+[[nodiscard]] std::string SanitizedShaderName(const std::filesystem::path& filepath) {
+    std::string nameofdata = Utf8PathString(filepath.stem());
+    std::replace(nameofdata.begin(), nameofdata.end(), '.', '_');
+    return nameofdata;
+}
+
+struct SpvInput {
+    std::filesystem::path path;
+    std::string name;
+};
+
+// Lists .spv files of directory sorted by byte-wise order of sanitized names,
+// so module doesn't depend on order of directory entries. Files with same
+// name (or, in reproducible mode, names differing only by case) are rejected
+[[nodiscard]] std::vector<SpvInput> ListSpvInputs(const std::filesystem::path& basepath, const bool reproducible) {
+    std::vector<SpvInput> inputs;
+    for (auto const& dir_entry : std::filesystem::directory_iterator{ basepath }) {
+        if (dir_entry.is_regular_file()) {
+            std::filesystem::path filepath{ dir_entry };
+            if (filepath.extension() == ".spv") {
+                std::string nameofdata = SanitizedShaderName(filepath);
+                inputs.emplace_back(SpvInput{ std::move(filepath), std::move(nameofdata) });
+            }
+        }
+    }
+    std::sort(inputs.begin(), inputs.end(), [](const SpvInput& a, const SpvInput& b) {
+        return a.name < b.name;
+    });
+
+    const auto lowercase = [](std::string str) {
+        std::transform(str.begin(), str.end(), str.begin(), [](const char c) {
+            return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+        });
+        return str;
+    };
+    std::unordered_map<std::string, const SpvInput*> seen;
+    for (const SpvInput& input : inputs) {
+        const auto [it, inserted] = seen.emplace(reproducible ? lowercase(input.name) : input.name, &input);
+        if (!inserted) {
+            throw std::runtime_error("Files " + Utf8PathString(it->second->path.filename()) + " and " +
+                Utf8PathString(input.path.filename()) + " give the same array name " + input.name);
+        }
+    }
+    return inputs;
+}
+
+[[nodiscard]] std::string ShaderArrayHeader(const std::string& nameofdata, const std::size_t size) {
+    return "\texport constinit std::array<const unsigned char, " + std::to_string(size) + "> " +
+        nameofdata + "_bytecode\n\t{\n\t\t";
+}
+
+constexpr std::string_view shader_array_footer{ "\n\t};\n" };
+
+// Type of elements of exported shader arrays
+enum class ArrayFormat {
+    bytes,
+    u32,
+    elf,
+    assembly,
+    embed,
+    string,
+    u64,
+    blob,
+    compact,
+    lz4
+};
+
+[[nodiscard]] std::string_view ArrayFormatName(const ArrayFormat format) noexcept {
+    switch (format) {
+    case ArrayFormat::u32:
+        return "u32";
+    case ArrayFormat::elf:
+        return "elf";
+    case ArrayFormat::assembly:
+        return "asm";
+    case ArrayFormat::embed:
+        return "embed";
+    case ArrayFormat::string:
+        return "string";
+    case ArrayFormat::u64:
+        return "u64";
+    case ArrayFormat::blob:
+        return "blob";
+    case ArrayFormat::compact:
+        return "compact";
+    case ArrayFormat::lz4:
+        return "lz4";
+    default:
+        return "bytes";
+    }
+}
+
+template<typename S>
+    requires requires {
+    std::is_same<S, std::string>::value || std::is_same<S, std::wstring>::value;
+}
+[[nodiscard]] ArrayFormat ParseArrayFormat(const std::deque<S>& values) {
+    for (const ArrayFormat format : { ArrayFormat::bytes, ArrayFormat::u32, ArrayFormat::elf, ArrayFormat::assembly, ArrayFormat::embed,
+                                      ArrayFormat::string, ArrayFormat::u64, ArrayFormat::blob, ArrayFormat::compact,
+                                      ArrayFormat::lz4 }) {
+        const std::string_view name = ArrayFormatName(format);
+        if (values.size() == 1 && S(name.begin(), name.end()) == values.front()) {
+            return format;
+        }
+    }
+    throw std::runtime_error("-format must be bytes, u32, u64, blob, compact, lz4, elf, asm, embed or string");
+}
+
+// Standard headers which are used by code of format
+[[nodiscard]] std::vector<std::string_view> FormatHeaders(const ArrayFormat format) {
+    std::vector<std::string_view> headers;
+    switch (format) {
+    case ArrayFormat::u32:
+        headers = { "array", "cstdint" };
+        break;
+    case ArrayFormat::elf:
+    case ArrayFormat::assembly:
+        headers = { "cstddef", "span" };
+        break;
+    case ArrayFormat::string:
+        headers = { "span" };
+        break;
+    case ArrayFormat::u64:
+    case ArrayFormat::compact:
+        headers = { "array", "cstddef", "cstdint", "span" };
+        break;
+    case ArrayFormat::blob:
+        headers = { "array", "cstddef", "cstdint", "span", "string_view" };
+        break;
+    case ArrayFormat::lz4:
+        headers = { "array", "atomic", "cstddef", "cstdint", "span", "thread", "vector" };
+        break;
+    default:
+        headers = { "array" };
+        break;
+    }
+    return headers;
+}
+
+// Headers of format with headers of shader lookup
+[[nodiscard]] std::vector<std::string_view> LookupHeaders(const ArrayFormat format) {
+    std::vector<std::string_view> headers = FormatHeaders(format);
+    headers.insert(headers.end(), { "array", "cstddef", "cstdint", "span", "string_view" });
+    std::sort(headers.begin(), headers.end());
+    headers.erase(std::unique(headers.begin(), headers.end()), headers.end());
+    return headers;
+}
+
+// Main module has shader lookup, so it also imports headers of lookup
+[[nodiscard]] std::string ModulePreamble(const ArrayFormat format, const std::string_view modulename = "shader_spv") {
+    const std::vector<std::string_view> headers = modulename == "shader_spv" ? LookupHeaders(format) :
+        FormatHeaders(format);
+    std::string text = "export module " + std::string(modulename) + ";\n\n";
+    for (const std::string_view header : headers) {
+        text += "import <" + std::string(header) + ">;\n";
+    }
+    return text + "\n";
+}
+
+// Accessor of u64 format, it is in module itself, in common module when shaders are in own modules
+// or in header
+[[nodiscard]] std::string SpvWordFunction(const bool exported) {
+    return std::string("namespace OnyWarp\n{\n"
+        "\t// Gives SPIRV word with index from array of words packed by two, first word is in low half\n\t") +
+        (exported ? "export " : "") +
+        "constexpr std::uint32_t SpvWord(const std::span<const std::uint64_t> data,"
+        " const std::size_t index) noexcept\n"
+        "\t{\n"
+        "\t\treturn static_cast<std::uint32_t>(data[index / 2] >> (32 * (index % 2)));\n"
+        "\t}\n"
+        "}\n\n";
+}
+
+// Flags of opcodes for compact format: bit 0 is result type, bit 1 is result id, bits 2-4 are number
+// of next operands which are ids. Flags only make data smaller, any opcode is encoded right without them
+constexpr std::array<std::uint8_t, 367> compact_opcode_flags = [] {
+    constexpr std::uint8_t type = 1;
+    constexpr std::uint8_t result = 2;
+    constexpr auto ids = [](const int count) { return static_cast<std::uint8_t>(count << 2); };
+    std::array<std::uint8_t, 367> table{};
+    const auto set = [&table](const std::size_t first, const std::size_t last, const std::uint8_t flags) {
+        for (std::size_t opcode = first; opcode <= last; opcode++) {
+            table[opcode] = flags;
+        }
+    };
+    set(1, 1, type | result);
+    set(5, 6, ids(1));
+    set(7, 7, result);
+    set(8, 8, ids(1));
+    set(11, 11, result);
+    set(12, 12, type | result | ids(1));
+    set(16, 16, ids(1));
+    set(19, 22, result);
+    set(23, 25, result | ids(1));
+    set(26, 26, result);
+    set(27, 27, result | ids(1));
+    set(28, 28, result | ids(2));
+    set(29, 29, result | ids(1));
+    set(30, 30, result | ids(7));
+    set(31, 32, result);
+    set(33, 33, result | ids(7));
+    set(41, 43, type | result);
+    set(44, 44, type | result | ids(7));
+    set(46, 50, type | result);
+    set(51, 51, type | result | ids(7));
+    set(52, 52, type | result);
+    set(54, 55, type | result);
+    set(57, 57, type | result | ids(7));
+    set(59, 59, type | result);
+    set(60, 60, type | result | ids(3));
+    set(61, 61, type | result | ids(1));
+    set(62, 63, ids(2));
+    set(65, 67, type | result | ids(7));
+    set(68, 68, type | result | ids(1));
+    set(71, 72, ids(1));
+    set(77, 77, type | result | ids(2));
+    set(78, 78, type | result | ids(3));
+    set(79, 79, type | result | ids(2));
+    set(80, 80, type | result | ids(7));
+    set(81, 81, type | result | ids(1));
+    set(82, 82, type | result | ids(2));
+    set(83, 84, type | result | ids(1));
+    set(86, 88, type | result | ids(2));
+    set(89, 90, type | result | ids(3));
+    set(91, 92, type | result | ids(2));
+    set(93, 94, type | result | ids(3));
+    set(95, 95, type | result | ids(2));
+    set(96, 97, type | result | ids(3));
+    set(98, 98, type | result | ids(2));
+    set(99, 99, ids(3));
+    set(100, 102, type | result | ids(1));
+    set(103, 103, type | result | ids(2));
+    set(104, 104, type | result | ids(1));
+    set(105, 105, type | result | ids(2));
+    set(106, 107, type | result | ids(1));
+    set(109, 124, type | result | ids(1));
+    set(126, 127, type | result | ids(1));
+    set(128, 152, type | result | ids(2));
+    set(154, 160, type | result | ids(1));
+    set(161, 167, type | result | ids(2));
+    set(168, 168, type | result | ids(1));
+    set(169, 169, type | result | ids(3));
+    set(170, 191, type | result | ids(2));
+    set(194, 199, type | result | ids(2));
+    set(200, 200, type | result | ids(1));
+    set(201, 201, type | result | ids(4));
+    set(202, 203, type | result | ids(3));
+    set(204, 205, type | result | ids(1));
+    set(207, 215, type | result | ids(1));
+    set(224, 224, ids(3));
+    set(225, 225, ids(2));
+    set(227, 227, type | result | ids(3));
+    set(228, 228, ids(4));
+    set(229, 229, type | result | ids(4));
+    set(230, 230, type | result | ids(6));
+    set(232, 233, type | result | ids(3));
+    set(234, 242, type | result | ids(4));
+    set(245, 245, type | result | ids(7));
+    set(246, 246, ids(2));
+    set(247, 247, ids(1));
+    set(248, 248, result);
+    set(249, 249, ids(1));
+    set(250, 250, ids(3));
+    set(251, 251, ids(2));
+    set(254, 254, ids(1));
+    set(333, 333, type | result | ids(1));
+    set(334, 366, type | result | ids(2));
+    return table;
+}();
+
+// Frequent opcodes are swapped with rare opcodes below 8, so header of their instruction takes one byte
+[[nodiscard]] constexpr std::uint32_t CompactOpcode(const std::uint32_t opcode) noexcept {
+    constexpr std::array<std::pair<std::uint32_t, std::uint32_t>, 5> swaps{ { { 1, 61 }, { 2, 62 }, { 3, 65 },
+                                                                              { 4, 71 }, { 7, 81 } } };
+    for (const auto& [rare, frequent] : swaps) {
+        if (opcode == rare || opcode == frequent) {
+            return opcode == rare ? frequent : rare;
+        }
+    }
+    return opcode;
+}
+
+// Decoder of compact format, it is in module itself, in common module when shaders are in own modules
+// or in header. It doesn't allocate and works in constant evaluation
+[[nodiscard]] std::string CompactDecoderFunctions(const bool exported) {
+    std::string text = "namespace OnyWarp\n{\n"
+        "\t// Bit 0 is result type, bit 1 is result id, bits 2-4 are number of next operands which are ids\n"
+        "\tinline constexpr std::array<std::uint8_t, " + std::to_string(compact_opcode_flags.size()) +
+        "> compact_opcode_flags\n\t{ {\n";
+    for (std::size_t i = 0; i < compact_opcode_flags.size(); i++) {
+        text += (i % 32 == 0 ? "\t\t" : "") + std::to_string(compact_opcode_flags[i]) + ",";
+        text += i % 32 == 31 || i + 1 == compact_opcode_flags.size() ? "\n" : "";
+    }
+    text += "\t} };\n\n";
+    text += "\tconstexpr std::uint32_t CompactOpcode(const std::uint32_t opcode) noexcept\n"
+        "\t{\n"
+        "\t\tswitch (opcode)\n\t\t{\n";
+    for (std::uint32_t opcode = 0; opcode < compact_opcode_flags.size(); opcode++) {
+        if (CompactOpcode(opcode) != opcode) {
+            text += "\t\tcase " + std::to_string(opcode) + ":\n\t\t\treturn " + std::to_string(CompactOpcode(opcode)) + ";\n";
+        }
+    }
+    text += "\t\tdefault:\n\t\t\treturn opcode;\n\t\t}\n\t}\n\n";
+    text += "\t// Reads LEB128 number, gives false at end of data or for too long number\n"
+        "\tconstexpr bool ReadCompactNumber(const std::span<const unsigned char> in, std::size_t& pos,"
+        " std::uint32_t& value) noexcept\n"
+        "\t{\n"
+        "\t\tif (pos < in.size() && in[pos] < 0x80)\n\t\t{\n"
+        "\t\t\tvalue = in[pos++];\n"
+        "\t\t\treturn true;\n"
+        "\t\t}\n"
+        "\t\tvalue = 0;\n"
+        "\t\tfor (std::uint32_t shift = 0; pos < in.size() && shift < 32; shift += 7)\n\t\t{\n"
+        "\t\t\tconst std::uint32_t byte = in[pos++];\n"
+        "\t\t\tvalue |= (byte & 0x7F) << shift;\n"
+        "\t\t\tif ((byte & 0x80) == 0)\n\t\t\t{\n\t\t\t\treturn true;\n\t\t\t}\n"
+        "\t\t}\n"
+        "\t\treturn false;\n"
+        "\t}\n\n";
+    text += "\t// Expands shader of compact format to SPIRV words of out, which must have <name>_word_count words.\n"
+        "\t// Gives number of written words or 0 when data is damaged or out is too small\n\t" +
+        std::string(exported ? "export " : "") +
+        "constexpr std::size_t DecodeShader(const std::span<const unsigned char> in,"
+        " const std::span<std::uint32_t> out) noexcept\n"
+        "\t{\n"
+        "\t\tstd::size_t pos = 0;\n"
+        "\t\tif (out.size() < 5)\n\t\t{\n\t\t\treturn 0;\n\t\t}\n"
+        "\t\tout[0] = 0x07230203u;\n"
+        "\t\tfor (std::size_t i = 1; i < 5; i++)\n\t\t{\n"
+        "\t\t\tif (!ReadCompactNumber(in, pos, out[i]))\n\t\t\t{\n\t\t\t\treturn 0;\n\t\t\t}\n"
+        "\t\t}\n"
+        "\t\tstd::size_t size = 5;\n"
+        "\t\tstd::uint32_t lastresult = 0;\n"
+        "\t\twhile (pos < in.size())\n\t\t{\n"
+        "\t\t\tstd::uint32_t header = 0;\n"
+        "\t\t\tif (!ReadCompactNumber(in, pos, header))\n\t\t\t{\n\t\t\t\treturn 0;\n\t\t\t}\n"
+        "\t\t\tconst std::uint32_t opcode = CompactOpcode(header >> 4);\n"
+        "\t\t\tstd::uint32_t count = header & 0xF;\n"
+        "\t\t\tif ((count == 0 && !ReadCompactNumber(in, pos, count)) || opcode > 0xFFFF ||\n"
+        "\t\t\t\tcount == 0 || count > 0xFFFF || count > out.size() - size)\n\t\t\t{\n"
+        "\t\t\t\treturn 0;\n\t\t\t}\n"
+        "\t\t\tconst std::uint32_t flags = opcode < compact_opcode_flags.size() ? compact_opcode_flags[opcode] : 0;\n"
+        "\t\t\tconst std::size_t end = size + count;\n"
+        "\t\t\tout[size++] = (count << 16) | opcode;\n"
+        "\t\t\tstd::uint32_t value = 0;\n"
+        "\t\t\tif ((flags & 1) != 0 && size < end)\n\t\t\t{\n"
+        "\t\t\t\tif (!ReadCompactNumber(in, pos, value))\n\t\t\t\t{\n\t\t\t\t\treturn 0;\n\t\t\t\t}\n"
+        "\t\t\t\tout[size++] = value;\n"
+        "\t\t\t}\n"
+        "\t\t\tstd::uint32_t base = lastresult;\n"
+        "\t\t\tif ((flags & 2) != 0 && size < end)\n\t\t\t{\n"
+        "\t\t\t\tif (!ReadCompactNumber(in, pos, value))\n\t\t\t\t{\n\t\t\t\t\treturn 0;\n\t\t\t\t}\n"
+        "\t\t\t\tbase = lastresult = lastresult + 1 + ((value >> 1) ^ (0u - (value & 1)));\n"
+        "\t\t\t\tout[size++] = base;\n"
+        "\t\t\t}\n"
+        "\t\t\tfor (std::uint32_t ids = flags >> 2; size < end; ids = ids > 0 ? ids - 1 : 0)\n\t\t\t{\n"
+        "\t\t\t\tif (!ReadCompactNumber(in, pos, value))\n\t\t\t\t{\n\t\t\t\t\treturn 0;\n\t\t\t\t}\n"
+        "\t\t\t\tout[size++] = ids > 0 ? base - ((value >> 1) ^ (0u - (value & 1))) : value;\n"
+        "\t\t\t}\n"
+        "\t\t}\n"
+        "\t\treturn size;\n"
+        "\t}\n"
+        "}\n\n";
+    return text;
+}
+
+// Size of independent blocks of lz4 format, every block can be decompressed by own thread
+constexpr std::size_t lz_block_size{ 64 * 1024 };
+
+// Decompressor of lz4 format, it is in module itself, in common module when shaders are in own modules
+// or in header. Shader is block count, end offsets of compressed blocks and blocks of LZ4 block format
+[[nodiscard]] std::string LzDecoderFunctions(const bool exported) {
+    const std::string exportword = exported ? "export " : "";
+    const std::string functionword = exported ? "export " : "inline ";
+    return "namespace OnyWarp\n{\n"
+        "\tinline constexpr std::size_t lz_block_size = " + std::to_string(lz_block_size) + ";\n\n"
+        "\tconstexpr std::uint32_t ReadLzNumber(const std::span<const unsigned char> in, const std::size_t pos) noexcept\n"
+        "\t{\n"
+        "\t\treturn in[pos] | (in[pos + 1] << 8) | (in[pos + 2] << 16) | (static_cast<std::uint32_t>(in[pos + 3]) << 24);\n"
+        "\t}\n\n"
+        "\t// Decompresses block of LZ4 block format, gives number of written bytes or 0 for damaged data\n\t" +
+        exportword + "constexpr std::size_t DecompressLzBlock(const std::span<const unsigned char> in,"
+        " const std::span<unsigned char> out) noexcept\n"
+        "\t{\n"
+        "\t\tstd::size_t ip = 0;\n"
+        "\t\tstd::size_t op = 0;\n"
+        "\t\twhile (ip < in.size())\n\t\t{\n"
+        "\t\t\tconst std::size_t token = in[ip++];\n"
+        "\t\t\tstd::size_t literals = token >> 4;\n"
+        "\t\t\tfor (std::size_t extra = literals == 15 ? 255 : 0; extra == 255; literals += extra)\n\t\t\t{\n"
+        "\t\t\t\tif (ip == in.size())\n\t\t\t\t{\n\t\t\t\t\treturn 0;\n\t\t\t\t}\n"
+        "\t\t\t\textra = in[ip++];\n"
+        "\t\t\t}\n"
+        "\t\t\tif (literals > in.size() - ip || literals > out.size() - op)\n\t\t\t{\n\t\t\t\treturn 0;\n\t\t\t}\n"
+        "\t\t\tfor (std::size_t i = 0; i < literals; i++)\n\t\t\t{\n"
+        "\t\t\t\tout[op + i] = in[ip + i];\n"
+        "\t\t\t}\n"
+        "\t\t\tip += literals;\n"
+        "\t\t\top += literals;\n"
+        "\t\t\t// Last sequence has only literals\n"
+        "\t\t\tif (ip == in.size())\n\t\t\t{\n\t\t\t\tbreak;\n\t\t\t}\n"
+        "\t\t\tif (in.size() - ip < 2)\n\t\t\t{\n\t\t\t\treturn 0;\n\t\t\t}\n"
+        "\t\t\tconst std::size_t offset = in[ip] | (in[ip + 1] << 8);\n"
+        "\t\t\tip += 2;\n"
+        "\t\t\tstd::size_t length = (token & 15) + 4;\n"
+        "\t\t\tfor (std::size_t extra = (token & 15) == 15 ? 255 : 0; extra == 255; length += extra)\n\t\t\t{\n"
+        "\t\t\t\tif (ip == in.size())\n\t\t\t\t{\n\t\t\t\t\treturn 0;\n\t\t\t\t}\n"
+        "\t\t\t\textra = in[ip++];\n"
+        "\t\t\t}\n"
+        "\t\t\tif (offset == 0 || offset > op || length > out.size() - op)\n\t\t\t{\n\t\t\t\treturn 0;\n\t\t\t}\n"
+        "\t\t\t// Match can overlap bytes which it writes\n"
+        "\t\t\tfor (std::size_t i = 0; i < length; i++)\n\t\t\t{\n"
+        "\t\t\t\tout[op + i] = out[op + i - offset];\n"
+        "\t\t\t}\n"
+        "\t\t\top += length;\n"
+        "\t\t}\n"
+        "\t\treturn op;\n"
+        "\t}\n\n"
+        "\t// Number of independent blocks of shader\n\t" +
+        exportword + "constexpr std::size_t LzBlockCount(const std::span<const unsigned char> in) noexcept\n"
+        "\t{\n"
+        "\t\treturn in.size() < 4 ? 0 : ReadLzNumber(in, 0);\n"
+        "\t}\n\n"
+        "\t// Decompresses block with index to its place in out, which has <name>_bytecode_size bytes.\n"
+        "\t// Gives false for damaged data\n\t" +
+        exportword + "constexpr bool DecompressLzBlockAt(const std::span<const unsigned char> in, const std::size_t index,\n"
+        "\t\tconst std::span<unsigned char> out) noexcept\n"
+        "\t{\n"
+        "\t\tconst std::size_t blocks = LzBlockCount(in);\n"
+        "\t\tconst std::size_t datastart = 4 + 4 * blocks;\n"
+        "\t\tif (index >= blocks || datastart > in.size() || index * lz_block_size >= out.size())\n\t\t{\n"
+        "\t\t\treturn false;\n\t\t}\n"
+        "\t\tconst std::size_t first = index == 0 ? 0 : ReadLzNumber(in, 4 * index);\n"
+        "\t\tconst std::size_t last = ReadLzNumber(in, 4 + 4 * index);\n"
+        "\t\tconst std::size_t size = out.size() - index * lz_block_size < lz_block_size ?\n"
+        "\t\t\tout.size() - index * lz_block_size : lz_block_size;\n"
+        "\t\treturn first <= last && last <= in.size() - datastart &&\n"
+        "\t\t\tDecompressLzBlock(in.subspan(datastart + first, last - first), out.subspan(index * lz_block_size, size)) == size;\n"
+        "\t}\n\n"
+        "\t// Decompresses all blocks of shader on calling thread\n\t" +
+        exportword + "constexpr bool DecompressShader(const std::span<const unsigned char> in,"
+        " const std::span<unsigned char> out) noexcept\n"
+        "\t{\n"
+        "\t\tconst std::size_t blocks = LzBlockCount(in);\n"
+        "\t\tif (blocks != (out.size() + lz_block_size - 1) / lz_block_size)\n\t\t{\n\t\t\treturn false;\n\t\t}\n"
+        "\t\tfor (std::size_t i = 0; i < blocks; i++)\n\t\t{\n"
+        "\t\t\tif (!DecompressLzBlockAt(in, i, out))\n\t\t\t{\n\t\t\t\treturn false;\n\t\t\t}\n"
+        "\t\t}\n"
+        "\t\treturn true;\n"
+        "\t}\n\n"
+        "\t" + exportword + "struct LzShaderJob\n\t{\n"
+        "\t\tstd::span<const unsigned char> data;\n"
+        "\t\tstd::span<unsigned char> out;\n"
+        "\t};\n\n"
+        "\t// Decompresses shaders on threads, every thread takes next block of any shader, so large shader\n"
+        "\t// is also decompressed by several threads. Gives false when any shader is damaged\n\t" +
+        functionword + "bool DecompressShaders(const std::span<const LzShaderJob> jobs, unsigned threads)\n"
+        "\t{\n"
+        "\t\tstd::vector<std::pair<std::size_t, std::size_t>> tasks;\n"
+        "\t\tfor (std::size_t i = 0; i < jobs.size(); i++)\n\t\t{\n"
+        "\t\t\tconst std::size_t blocks = LzBlockCount(jobs[i].data);\n"
+        "\t\t\tif (blocks != (jobs[i].out.size() + lz_block_size - 1) / lz_block_size)\n\t\t\t{\n"
+        "\t\t\t\treturn false;\n\t\t\t}\n"
+        "\t\t\tfor (std::size_t k = 0; k < blocks; k++)\n\t\t\t{\n"
+        "\t\t\t\ttasks.emplace_back(i, k);\n"
+        "\t\t\t}\n"
+        "\t\t}\n"
+        "\t\tstd::atomic<std::size_t> next{ 0 };\n"
+        "\t\tstd::atomic<bool> result{ true };\n"
+        "\t\tconst auto work = [&]()\n\t\t{\n"
+        "\t\t\tfor (std::size_t task = next++; task < tasks.size(); task = next++)\n\t\t\t{\n"
+        "\t\t\t\tconst LzShaderJob& job = jobs[tasks[task].first];\n"
+        "\t\t\t\tif (!DecompressLzBlockAt(job.data, tasks[task].second, job.out))\n\t\t\t\t{\n"
+        "\t\t\t\t\tresult = false;\n\t\t\t\t}\n"
+        "\t\t\t}\n"
+        "\t\t};\n"
+        "\t\tthreads = threads == 0 ? 1 : static_cast<unsigned>(threads < tasks.size() ? threads : tasks.size());\n"
+        "\t\tstd::vector<std::thread> pool;\n"
+        "\t\tfor (unsigned i = 1; i < threads; i++)\n\t\t{\n"
+        "\t\t\tpool.emplace_back(work);\n"
+        "\t\t}\n"
+        "\t\twork();\n"
+        "\t\tfor (std::thread& thread : pool)\n\t\t{\n"
+        "\t\t\tthread.join();\n"
+        "\t\t}\n"
+        "\t\treturn result;\n"
+        "\t}\n"
+        "}\n\n";
+}
+
+// Helpers of format which are shared by all shaders: they are in module itself, in common module
+// when shaders are in own modules or in header
+[[nodiscard]] std::string CommonDefinitions(const ArrayFormat format, const bool exported) {
+    switch (format) {
+    case ArrayFormat::u64:
+        return SpvWordFunction(exported);
+    case ArrayFormat::compact:
+        return CompactDecoderFunctions(exported);
+    case ArrayFormat::lz4:
+        return LzDecoderFunctions(exported);
+    default:
+        return "";
+    }
+}
+
+// Where shader blocks go: module exports arrays, source file keeps arrays internal
+// and defines spans declared in header
+enum class BlockLinkage {
+    module,
+    source
+};
+
+[[nodiscard]] std::string DataArrayHeader(const BlockLinkage linkage, const bool aligned,
+                                          const std::string& declaration, const std::string& nameofdata) {
+    const std::string alignment = aligned ? "alignas(4) " : "";
+    return linkage == BlockLinkage::module ?
+        "\texport " + alignment + declaration + " " + nameofdata + "_bytecode\n\t{\n\t\t" :
+        "\t" + alignment + "static " + declaration + " " + nameofdata + "_bytecode_data\n\t{\n\t\t";
+}
+
+// Type of span which shows shader data of format in header and source files
+[[nodiscard]] std::string ShaderSpanType(const ArrayFormat format, const std::uintmax_t size) {
+    switch (format) {
+    case ArrayFormat::u32:
+        return "std::span<const std::uint32_t, " + std::to_string(size / sizeof(std::uint32_t)) + ">";
+    case ArrayFormat::u64:
+        return "std::span<const std::uint64_t, " + std::to_string((size / sizeof(std::uint32_t) + 1) / 2) + ">";
+    case ArrayFormat::compact:
+    case ArrayFormat::lz4:
+        // Header knows only size of decoded shader
+        return "std::span<const unsigned char>";
+    default:
+        return "std::span<const unsigned char, " + std::to_string(size) + ">";
+    }
+}
+
+[[nodiscard]] std::string SourceSpanDefinition(const ArrayFormat format, const std::string& nameofdata,
+                                               const std::uintmax_t size) {
+    return "\tconst " + ShaderSpanType(format, size) + " " + nameofdata + "_bytecode{ " + nameofdata +
+        "_bytecode_data };\n";
+}
+
+[[nodiscard]] std::string HeaderPreamble(const ArrayFormat format) {
+    std::string text = "#pragma once\n\n";
+    for (const std::string_view header : LookupHeaders(format)) {
+        text += "#include <" + std::string(header) + ">\n";
+    }
+    return text + "\n" + CommonDefinitions(format, false) + "namespace OnyWarp\n{\n";
+}
+
+// Header has span of every shader defined in source file and constexpr size of shader in bytes.
+// Duplicate of other shader has reference to span of original shader instead of own span
+[[nodiscard]] std::string HeaderDeclaration(const ArrayFormat format, const std::string& nameofdata,
+                                            const std::uintmax_t size, const std::string_view original = {}) {
+    std::string text = original.empty() ?
+        "\textern const " + ShaderSpanType(format, size) + " " + nameofdata + "_bytecode;\n" :
+        "\tinline constexpr const " + ShaderSpanType(format, size) + "& " + nameofdata + "_bytecode = " +
+            std::string(original) + "_bytecode;\n";
+    text += "\tinline constexpr std::size_t " + nameofdata + "_bytecode_size = " + std::to_string(size) + ";\n";
+    if (format == ArrayFormat::u64 || format == ArrayFormat::compact) {
+        text += "\tinline constexpr std::size_t " + nameofdata + "_word_count = " +
+            std::to_string(size / sizeof(std::uint32_t)) + ";\n";
+    }
+    return text;
+}
+
+// Module of helpers shared by modules of shaders
+constexpr std::string_view common_module_name{ "shader_spv_common" };
+
+// Formats which give only one module file
+[[nodiscard]] bool IsSingleFileFormat(const ArrayFormat format) noexcept {
+    return format == ArrayFormat::elf || format == ArrayFormat::assembly || format == ArrayFormat::blob;
+}
+
+// Stage of shader by extension of source file in name of SPIRV file (name.vert.spv)
+[[nodiscard]] std::string_view ShaderStageName(const std::filesystem::path& spvpath) {
+    const std::string extension = spvpath.stem().extension().string();
+    for (std::size_t i = 0; i < shadertypes.size(); i++) {
+        if (extension == shadertypes[i]) {
+            return shaderstages[i];
+        }
+    }
+    return "unknown";
+}
+
+// Types of blob format: all shaders are in one array of words and table describes them
+[[nodiscard]] std::string BlobDefinitions() {
+    std::string text = "\texport enum class ShaderStage : std::uint32_t\n\t{\n";
+    for (const char* stage : shaderstages) {
+        text += "\t\t" + std::string(stage) + ",\n";
+    }
+    text += "\t\tunknown\n\t};\n\n";
+    text += "\t// Offset and size are in words of shader_blob\n";
+    text += "\texport struct ShaderBlobEntry\n\t{\n";
+    text += "\t\tstd::string_view name;\n\t\tstd::size_t offset;\n\t\tstd::size_t size;\n\t\tShaderStage stage;\n";
+    text += "\t};\n\n";
+    text += "\texport alignas(64) inline constinit const std::uint32_t shader_blob[]\n\t{\n";
+    return text;
+}
+
+// Hash of shader name for lookup, generated module has the same function
+[[nodiscard]] constexpr std::uint32_t ShaderNameHash(const std::string_view name, const std::uint32_t seed) noexcept {
+    std::uint32_t hash = 2166136261u ^ seed;
+    for (const char c : name) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;
+    }
+    hash ^= hash >> 15;
+    hash *= 0x2C1B3C6Du;
+    return hash ^ (hash >> 12);
+}
+
+// Minimal perfect hash of names (CHD): names are put to buckets by hash with seed 0, then every
+// bucket from biggest one gets seed which sends its names to free slots. Bucket with one name
+// keeps its slot as negative seed
+struct ShaderNameTable {
+    std::vector<std::size_t> slots;
+    std::vector<std::int32_t> seeds;
+};
+
+[[nodiscard]] ShaderNameTable MakeShaderNameTable(const std::vector<std::string_view>& names) {
+    constexpr std::size_t freeslot = static_cast<std::size_t>(-1);
+    constexpr std::int32_t maxseed = 1 << 20;
+    ShaderNameTable table;
+    table.slots.assign(names.size(), freeslot);
+    table.seeds.assign(std::max<std::size_t>((names.size() + 1) / 2, 1), 0);
+    std::vector<std::vector<std::size_t>> buckets(table.seeds.size());
+    for (std::size_t i = 0; i < names.size(); i++) {
+        buckets[ShaderNameHash(names[i], 0) % buckets.size()].push_back(i);
+    }
+    std::vector<std::size_t> order(buckets.size());
+    for (std::size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&buckets](const std::size_t a, const std::size_t b) {
+        return buckets[a].size() > buckets[b].size();
+    });
+
+    std::size_t nextfree{ 0 };
+    std::vector<std::size_t> candidate;
+    for (const std::size_t bucket : order) {
+        const std::vector<std::size_t>& members = buckets[bucket];
+        if (members.size() == 1) {
+            while (table.slots[nextfree] != freeslot) {
+                nextfree++;
+            }
+            table.slots[nextfree] = members.front();
+            table.seeds[bucket] = -static_cast<std::int32_t>(nextfree) - 1;
+            continue;
+        }
+        for (std::int32_t seed = 1; !members.empty(); seed++) {
+            if (seed == maxseed) {
+                throw std::runtime_error("Unable to make perfect hash of shader names");
+            }
+            candidate.clear();
+            for (const std::size_t member : members) {
+                const std::size_t slot = ShaderNameHash(names[member], static_cast<std::uint32_t>(seed)) % names.size();
+                if (table.slots[slot] != freeslot || std::find(candidate.begin(), candidate.end(), slot) != candidate.end()) {
+                    break;
+                }
+                candidate.push_back(slot);
+            }
+            if (candidate.size() == members.size()) {
+                for (std::size_t i = 0; i < members.size(); i++) {
+                    table.slots[candidate[i]] = members[i];
+                }
+                table.seeds[bucket] = seed;
+                break;
+            }
+        }
+    }
+    return table;
+}
+
+// Type of shader data given by lookup
+[[nodiscard]] std::string_view LookupElementType(const ArrayFormat format) noexcept {
+    switch (format) {
+    case ArrayFormat::u32:
+    case ArrayFormat::blob:
+        return "std::uint32_t";
+    case ArrayFormat::u64:
+        return "std::uint64_t";
+    default:
+        return "unsigned char";
+    }
+}
+
+// Lookup of shaders by name: find_shader gives data of shader or empty span for unknown name. In module it
+// is constexpr, header only declares spans defined in source files, so there it is inline
+[[nodiscard]] std::string ShaderLookup(const ArrayFormat format, const BlockLinkage linkage,
+                                       const std::vector<std::string_view>& names) {
+    const ShaderNameTable table = MakeShaderNameTable(names);
+    const std::string exported = linkage == BlockLinkage::module ? "export " : "";
+    std::string text = "\t// Minimal perfect hash of shader names: bucket of name by hash with seed 0 has seed of slot hash,\n"
+        "\t// negative seed is slot itself\n"
+        "\tconstexpr std::uint32_t ShaderNameHash(const std::string_view name, const std::uint32_t seed) noexcept\n"
+        "\t{\n"
+        "\t\tstd::uint32_t hash = 2166136261u ^ seed;\n"
+        "\t\tfor (const char c : name)\n\t\t{\n"
+        "\t\t\thash = (hash ^ static_cast<unsigned char>(c)) * 16777619u;\n"
+        "\t\t}\n"
+        "\t\thash ^= hash >> 15;\n"
+        "\t\thash *= 0x2C1B3C6Du;\n"
+        "\t\treturn hash ^ (hash >> 12);\n"
+        "\t}\n\n";
+    text += "\tinline constexpr std::array<std::int32_t, " + std::to_string(table.seeds.size()) +
+        "> shader_name_seeds\n\t{ {\n";
+    for (std::size_t i = 0; i < table.seeds.size(); i++) {
+        text += (i % 16 == 0 ? "\t\t" : " ") + std::to_string(table.seeds[i]) + ",";
+        text += i % 16 == 15 || i + 1 == table.seeds.size() ? "\n" : "";
+    }
+    text += "\t} };\n\n";
+    text += "\tinline constexpr std::array<std::string_view, " + std::to_string(names.size()) +
+        "> shader_names\n\t{ {\n";
+    for (const std::size_t index : table.slots) {
+        text += "\t\t\"" + std::string(names[index]) + "\",\n";
+    }
+    text += "\t} };\n\n";
+    text += "\t// Gives slot of shader in shader_names or shader_names.size() for unknown name\n\t" + exported +
+        "constexpr std::size_t FindShaderIndex(const std::string_view name) noexcept\n"
+        "\t{\n"
+        "\t\tif (shader_names.empty())\n\t\t{\n\t\t\treturn 0;\n\t\t}\n"
+        "\t\tconst std::int32_t seed = shader_name_seeds[ShaderNameHash(name, 0) % shader_name_seeds.size()];\n"
+        "\t\tconst std::size_t slot = seed < 0 ? static_cast<std::size_t>(-(seed + 1)) :\n"
+        "\t\t\tShaderNameHash(name, static_cast<std::uint32_t>(seed)) % shader_names.size();\n"
+        "\t\treturn shader_names[slot] == name ? slot : shader_names.size();\n"
+        "\t}\n\n";
+    text += "\t" + exported + (linkage == BlockLinkage::module ? "constexpr" : "inline") + " std::span<const " +
+        std::string(LookupElementType(format)) + "> find_shader(const std::string_view name) noexcept\n"
+        "\t{\n\t\tswitch (FindShaderIndex(name))\n\t\t{\n";
+    for (std::size_t i = 0; i < table.slots.size(); i++) {
+        text += "\t\tcase " + std::to_string(i) + ":\n\t\t\treturn " + std::string(names[table.slots[i]]) +
+            "_bytecode;\n";
+    }
+    text += "\t\tdefault:\n\t\t\treturn {};\n\t\t}\n\t}\n";
+    return text;
+}
+
+// SPIR-V word byte order is given by magic number, data without magic is taken as little-endian
+[[nodiscard]] std::endian SpvByteOrder(const std::span<const std::byte> data) noexcept {
+    constexpr std::array<std::byte, 4> bigmagic{ std::byte{ 0x07 }, std::byte{ 0x23 },
+                                                 std::byte{ 0x02 }, std::byte{ 0x03 } };
+    return data.size() >= 4 && std::equal(bigmagic.begin(), bigmagic.end(), data.begin()) ?
+        std::endian::big : std::endian::little;
+}
+
+// Opcodes of SPIR-V instructions which converter looks at
+enum class SpvOpcode : std::uint32_t {
+    source_continued = 2,
+    source = 3,
+    source_extension = 4,
+    name = 5,
+    member_name = 6,
+    string = 7,
+    line = 8,
+    extension = 10,
+    ext_inst_import = 11,
+    ext_inst = 12,
+    memory_model = 14,
+    entry_point = 15,
+    function = 54,
+    function_end = 56,
+    no_line = 317,
+    module_processed = 330
+};
+
+constexpr std::uint32_t spv_magic{ 0x07230203 };
+constexpr std::size_t spv_header_words{ 5 };
+// Universal limit of SPIR-V specification
+constexpr std::uint32_t spv_max_id_bound{ 4194303 };
+
+// Word with index of SPIR-V data in given byte order
+[[nodiscard]] std::uint32_t SpvWordAt(const std::span<const std::byte> data, const std::size_t index,
+                                      const std::endian order) noexcept {
+    std::uint32_t word{ 0 };
+    for (std::size_t k = 0; k < sizeof(word); k++) {
+        const std::size_t byteindex = order == std::endian::little ? sizeof(word) - 1 - k : k;
+        word = (word << 8) | static_cast<std::uint8_t>(data[index * sizeof(word) + byteindex]);
+    }
+    return word;
+}
+
+// Literal string in words [first, last), its first char is in lowest byte of word
+[[nodiscard]] std::string SpvLiteralString(const std::span<const std::byte> data, const std::size_t first,
+                                           const std::size_t last, const std::endian order) {
+    std::string text;
+    for (std::size_t i = first; i < last; i++) {
+        const std::uint32_t word = SpvWordAt(data, i, order);
+        for (std::size_t k = 0; k < sizeof(word); k++) {
+            const char c = static_cast<char>((word >> (8 * k)) & 0xFF);
+            if (c == '\0') {
+                return text;
+            }
+            text += c;
+        }
+    }
+    return text;
+}
+
+// Groups of SPIR-V instructions which driver doesn't need, they can be removed before encoding.
+// OpString is removed when lines and source are removed and no kept instruction can use it
+struct SpvStripOptions {
+    bool names{ false };        // OpName, OpMemberName
+    bool lines{ false };        // OpLine, OpNoLine
+    bool source{ false };       // OpSource, OpSourceContinued, OpSourceExtension, OpModuleProcessed
+    bool nonsemantic{ false };  // NonSemantic.* instruction sets, their instructions and extension
+};
+
+template<typename S>
+    requires requires {
+    std::is_same<S, std::string>::value || std::is_same<S, std::wstring>::value;
+}
+[[nodiscard]] SpvStripOptions ParseStripOptions(const std::deque<S>& values) {
+    SpvStripOptions strip;
+    const auto is = [](const S& value, const std::string_view name) {
+        return S(name.begin(), name.end()) == value;
+    };
+    for (const S& value : values) {
+        if (is(value, "names") || is(value, "debug") || is(value, "all")) {
+            strip.names = true;
+        }
+        if (is(value, "lines") || is(value, "debug") || is(value, "all")) {
+            strip.lines = true;
+        }
+        if (is(value, "source") || is(value, "debug") || is(value, "all")) {
+            strip.source = true;
+        }
+        if (is(value, "nonsemantic") || is(value, "all")) {
+            strip.nonsemantic = true;
+        }
+        if (!is(value, "names") && !is(value, "lines") && !is(value, "source") && !is(value, "nonsemantic") &&
+            !is(value, "debug") && !is(value, "all")) {
+            throw std::runtime_error("-strip must be list of names, lines, source, nonsemantic, debug or all");
+        }
+    }
+    return strip;
+}
+
+// Name of stripped groups for incremental state, blocks of other stripping are not reused
+[[nodiscard]] std::string StripOptionsName(const SpvStripOptions& strip) {
+    std::string text;
+    for (const auto& [enabled, name] : { std::pair{ strip.names, "names" }, std::pair{ strip.lines, "lines" },
+                                         std::pair{ strip.source, "source" }, std::pair{ strip.nonsemantic, "nonsemantic" } }) {
+        if (enabled) {
+            text += text.empty() ? name : "," + std::string(name);
+        }
+    }
+    return text;
+}
+
+// Checks header and instruction stream of SPIR-V module, gives problem or nothing for valid module.
+// It finds files truncated or damaged by interrupted compiler, semantics of module is not checked
+[[nodiscard]] std::optional<std::string> ValidateSpvModule(const std::span<const std::byte> data) {
+    if (data.size() % sizeof(std::uint32_t) != 0) {
+        return "size " + std::to_string(data.size()) + " is not multiple of 4";
+    }
+    const std::size_t words = data.size() / sizeof(std::uint32_t);
+    if (words < spv_header_words) {
+        return std::string("file is shorter than SPIRV header");
+    }
+    const std::endian order = SpvByteOrder(data);
+    if (SpvWordAt(data, 0, order) != spv_magic) {
+        return std::string("wrong magic number");
+    }
+    const std::uint32_t version = SpvWordAt(data, 1, order);
+    if ((version >> 16) != 1 || (version & 0xFF) != 0) {
+        return "unknown version " + std::to_string(version >> 16) + "." + std::to_string((version >> 8) & 0xFF);
+    }
+    const std::uint32_t bound = SpvWordAt(data, 3, order);
+    if (bound == 0 || bound > spv_max_id_bound) {
+        return "wrong ID bound " + std::to_string(bound);
+    }
+    if (SpvWordAt(data, 4, order) != 0) {
+        return std::string("reserved header word is not 0");
+    }
+
+    bool memorymodel{ false };
+    std::size_t openfunctions{ 0 };
+    std::vector<std::uint32_t> entrypoints;
+    std::vector<std::uint32_t> functions;
+    for (std::size_t i = spv_header_words; i < words; ) {
+        const std::uint32_t word = SpvWordAt(data, i, order);
+        const SpvOpcode opcode = static_cast<SpvOpcode>(word & 0xFFFF);
+        const std::size_t count = word >> 16;
+        if (count == 0 || count > words - i) {
+            return "instruction at word " + std::to_string(i) + " has word count " + std::to_string(count) +
+                ", " + std::to_string(words - i) + " words are left";
+        }
+        // Result id is after optional result type
+        const std::uint32_t flags = (word & 0xFFFF) < compact_opcode_flags.size() ? compact_opcode_flags[word & 0xFFFF] : 0;
+        const std::size_t resultindex = i + 1 + (flags & 1);
+        if ((flags & 2) != 0 && resultindex < i + count) {
+            const std::uint32_t result = SpvWordAt(data, resultindex, order);
+            if (result == 0 || result >= bound) {
+                return "result ID " + std::to_string(result) + " at word " + std::to_string(i) +
+                    " is out of ID bound " + std::to_string(bound);
+            }
+            if (opcode == SpvOpcode::function) {
+                functions.push_back(result);
+            }
+        }
+        if (opcode == SpvOpcode::memory_model) {
+            memorymodel = true;
+        }
+        else if (opcode == SpvOpcode::entry_point && count > 2) {
+            entrypoints.push_back(SpvWordAt(data, i + 2, order));
+        }
+        else if (opcode == SpvOpcode::function) {
+            openfunctions++;
+        }
+        else if (opcode == SpvOpcode::function_end) {
+            if (openfunctions == 0) {
+                return "OpFunctionEnd at word " + std::to_string(i) + " has no OpFunction";
+            }
+            openfunctions--;
+        }
+        i += count;
+    }
+    if (!memorymodel) {
+        return std::string("module has no OpMemoryModel");
+    }
+    // Truncated module ends inside of function or loses functions of entry points
+    if (openfunctions != 0) {
+        return std::string("module ends inside of function");
+    }
+    std::sort(functions.begin(), functions.end());
+    for (const std::uint32_t entrypoint : entrypoints) {
+        if (!std::binary_search(functions.begin(), functions.end(), entrypoint)) {
+            return "function " + std::to_string(entrypoint) + " of entry point is not in module";
+        }
+    }
+    return std::nullopt;
+}
+
+// Copies SPIR-V module without instructions of stripped groups to out, kept instructions are copied
+// as they are, so byte order is kept. Gives false for data which isn't valid module
+[[nodiscard]] bool StripSpvModule(const std::span<const std::byte> data, const SpvStripOptions& strip,
+                                  std::vector<std::byte>& out) {
+    const std::endian order = SpvByteOrder(data);
+    const std::size_t words = data.size() / sizeof(std::uint32_t);
+    if (data.size() % sizeof(std::uint32_t) != 0 || words < spv_header_words || SpvWordAt(data, 0, order) != spv_magic) {
+        return false;
+    }
+    // Instruction sets are imported before debug instructions and functions, but instructions are
+    // checked to be inside module before anything is removed
+    std::vector<std::uint32_t> nonsemanticsets;
+    for (std::size_t i = spv_header_words; i < words; ) {
+        const std::uint32_t word = SpvWordAt(data, i, order);
+        const std::size_t count = word >> 16;
+        if (count == 0 || count > words - i) {
+            return false;
+        }
+        if (static_cast<SpvOpcode>(word & 0xFFFF) == SpvOpcode::ext_inst_import && count >= 3 &&
+            SpvLiteralString(data, i + 2, i + count, order).starts_with("NonSemantic.")) {
+            nonsemanticsets.push_back(SpvWordAt(data, i + 1, order));
+        }
+        i += count;
+    }
+    const auto isnonsemantic = [&nonsemanticsets](const std::uint32_t set) {
+        return std::find(nonsemanticsets.begin(), nonsemanticsets.end(), set) != nonsemanticsets.end();
+    };
+    // NonSemantic debug info and printf refer to OpString
+    const bool strings = strip.lines && strip.source && (strip.nonsemantic || nonsemanticsets.empty());
+
+    out.clear();
+    out.reserve(data.size());
+    out.insert(out.end(), data.begin(), data.begin() + spv_header_words * sizeof(std::uint32_t));
+    for (std::size_t i = spv_header_words; i < words; ) {
+        const std::uint32_t word = SpvWordAt(data, i, order);
+        const std::size_t count = word >> 16;
+        bool removed{ false };
+        switch (static_cast<SpvOpcode>(word & 0xFFFF)) {
+        case SpvOpcode::name:
+        case SpvOpcode::member_name:
+            removed = strip.names;
+            break;
+        case SpvOpcode::line:
+        case SpvOpcode::no_line:
+            removed = strip.lines;
+            break;
+        case SpvOpcode::source:
+        case SpvOpcode::source_continued:
+        case SpvOpcode::source_extension:
+        case SpvOpcode::module_processed:
+            removed = strip.source;
+            break;
+        case SpvOpcode::string:
+            removed = strings;
+            break;
+        case SpvOpcode::extension:
+            removed = strip.nonsemantic && SpvLiteralString(data, i + 1, i + count, order) == "SPV_KHR_non_semantic_info";
+            break;
+        case SpvOpcode::ext_inst_import:
+            removed = strip.nonsemantic && count >= 2 && isnonsemantic(SpvWordAt(data, i + 1, order));
+            break;
+        case SpvOpcode::ext_inst:
+            removed = strip.nonsemantic && count >= 5 && isnonsemantic(SpvWordAt(data, i + 3, order));
+            break;
+        default:
+            break;
+        }
+        if (!removed) {
+            out.insert(out.end(), data.begin() + i * sizeof(std::uint32_t), data.begin() + (i + count) * sizeof(std::uint32_t));
+        }
+        i += count;
+    }
+    return true;
+}
+
+// Appends LEB128 number
+void AppendCompactNumber(std::vector<std::byte>& out, std::uint32_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<std::byte>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<std::byte>(value));
+}
+
+// Compact format in spirit of SMOL-V: instruction header is one LEB128 number with opcode and word count,
+// other words of SPIR-V module are LEB128 numbers, result id is difference
+// with previous result id and id operands are difference with result id, both in zigzag form, so most
+// words take one byte. Magic is not stored, decoder gives words in byte order of target
+[[nodiscard]] std::vector<std::byte> CompactSpvModule(const std::span<const std::byte> data, const std::string& nameofdata) {
+    const std::endian order = SpvByteOrder(data);
+    const std::size_t words = data.size() / sizeof(std::uint32_t);
+    if (data.size() % sizeof(std::uint32_t) != 0 || words < spv_header_words || SpvWordAt(data, 0, order) != spv_magic) {
+        throw std::runtime_error("Shader " + nameofdata + " is not valid SPIRV module, compact format needs it");
+    }
+    const auto zigzag = [](const std::uint32_t value) {
+        return (value << 1) ^ (0u - (value >> 31));
+    };
+    std::vector<std::byte> out;
+    out.reserve(data.size() / 2);
+    for (std::size_t i = 1; i < spv_header_words; i++) {
+        AppendCompactNumber(out, SpvWordAt(data, i, order));
+    }
+    std::uint32_t lastresult{ 0 };
+    for (std::size_t i = spv_header_words; i < words; ) {
+        const std::uint32_t word = SpvWordAt(data, i, order);
+        const std::uint32_t opcode = word & 0xFFFF;
+        const std::size_t count = word >> 16;
+        if (count == 0 || count > words - i) {
+            throw std::runtime_error("Shader " + nameofdata + " has broken instruction at word " + std::to_string(i));
+        }
+        const std::uint32_t flags = opcode < compact_opcode_flags.size() ? compact_opcode_flags[opcode] : 0;
+        const std::size_t end = i + count;
+        // Instruction header is opcode and word count, longer instructions have word count in next number
+        AppendCompactNumber(out, (CompactOpcode(opcode) << 4) | (count < 16 ? static_cast<std::uint32_t>(count) : 0));
+        if (count >= 16) {
+            AppendCompactNumber(out, static_cast<std::uint32_t>(count));
+        }
+        i++;
+        if ((flags & 1) != 0 && i < end) {
+            AppendCompactNumber(out, SpvWordAt(data, i++, order));
+        }
+        std::uint32_t base = lastresult;
+        if ((flags & 2) != 0 && i < end) {
+            base = SpvWordAt(data, i++, order);
+            AppendCompactNumber(out, zigzag(base - lastresult - 1));
+            lastresult = base;
+        }
+        for (std::uint32_t ids = flags >> 2; i < end; ids = ids > 0 ? ids - 1 : 0) {
+            const std::uint32_t value = SpvWordAt(data, i++, order);
+            AppendCompactNumber(out, ids > 0 ? zigzag(base - value) : value);
+        }
+    }
+    return out;
+}
+
+// Compresses block to LZ4 block format with greedy matches found by hash of 4 bytes. As format needs,
+// last 5 bytes are literals and match doesn't start in last 12 bytes
+void CompressLzBlock(const std::span<const std::byte> in, std::vector<std::byte>& out) {
+    constexpr std::size_t min_match = 4;
+    constexpr std::size_t last_literals = 5;
+    constexpr std::size_t match_limit = 12;
+    constexpr std::size_t max_offset = 65535;
+    constexpr int hash_bits = 12;
+    const auto read = [&in](const std::size_t pos) {
+        std::uint32_t value;
+        std::memcpy(&value, in.data() + pos, sizeof(value));
+        return value;
+    };
+    const auto appendlength = [&out](std::size_t length) {
+        for (; length >= 255; length -= 255) {
+            out.push_back(std::byte{ 255 });
+        }
+        out.push_back(static_cast<std::byte>(length));
+    };
+    const auto appendliterals = [&](const std::size_t from, const std::size_t to, const std::size_t matchlength) {
+        const std::size_t literals = to - from;
+        const std::size_t matchcode = matchlength == 0 ? 0 : matchlength - min_match;
+        out.push_back(static_cast<std::byte>((std::min<std::size_t>(literals, 15) << 4) | std::min<std::size_t>(matchcode, 15)));
+        if (literals >= 15) {
+            appendlength(literals - 15);
+        }
+        out.insert(out.end(), in.begin() + from, in.begin() + to);
+    };
+
+    std::array<std::int32_t, 1 << hash_bits> table;
+    table.fill(-1);
+    std::size_t anchor{ 0 };
+    std::size_t pos{ 0 };
+    std::size_t misses{ 0 };
+    while (in.size() >= match_limit && pos <= in.size() - match_limit) {
+        const std::uint32_t sequence = read(pos);
+        const std::size_t hash = (sequence * 2654435761u) >> (32 - hash_bits);
+        const std::int32_t candidate = table[hash];
+        table[hash] = static_cast<std::int32_t>(pos);
+        if (candidate < 0 || pos - candidate > max_offset || read(candidate) != sequence) {
+            // Data without matches is skipped faster
+            pos += 1 + (misses++ >> 6);
+            continue;
+        }
+        misses = 0;
+        std::size_t length = min_match;
+        while (pos + length < in.size() - last_literals && in[candidate + length] == in[pos + length]) {
+            length++;
+        }
+        appendliterals(anchor, pos, length);
+        const std::size_t offset = pos - candidate;
+        out.push_back(static_cast<std::byte>(offset & 0xFF));
+        out.push_back(static_cast<std::byte>(offset >> 8));
+        if (length - min_match >= 15) {
+            appendlength(length - min_match - 15);
+        }
+        pos += length;
+        anchor = pos;
+    }
+    appendliterals(anchor, in.size(), 0);
+}
+
+// lz4 format: block count, end offsets of compressed blocks and blocks which are compressed independently,
+// so they can be decompressed at once. Numbers are little-endian
+[[nodiscard]] std::vector<std::byte> CompressLzShader(const std::span<const std::byte> data) {
+    const std::size_t blocks = (data.size() + lz_block_size - 1) / lz_block_size;
+    const auto appendnumber = [](std::vector<std::byte>& out, const std::size_t pos, const std::size_t value) {
+        for (std::size_t k = 0; k < 4; k++) {
+            out[pos + k] = static_cast<std::byte>((value >> (8 * k)) & 0xFF);
+        }
+    };
+    std::vector<std::byte> out(4 + 4 * blocks);
+    appendnumber(out, 0, blocks);
+    const std::size_t datastart = out.size();
+    for (std::size_t i = 0; i < blocks; i++) {
+        CompressLzBlock(data.subspan(i * lz_block_size, std::min(lz_block_size, data.size() - i * lz_block_size)), out);
+        appendnumber(out, 4 + 4 * i, out.size() - datastart);
+    }
+    return out;
+}
+
+// Encodes data as W literals with values of words in given byte order, so the
+// array has the same words in memory of target with any endianness. 32 bytes in line
+template<typename W>
+void EncodeWordLiterals(const std::span<const std::byte> data, const std::endian order, std::string& out) {
+    constexpr std::size_t words_in_line = 32 / sizeof(W);
+    constexpr std::size_t chars_in_word = 2 * sizeof(W) + 3;
+    const std::size_t words = data.size() / sizeof(W);
+    std::size_t pos = out.size();
+    out.resize(pos + words * chars_in_word + (words / words_in_line) * HexEncoder::chars_in_line_break);
+    for (std::size_t i = 0; i < words; i++) {
+        const std::byte* src = data.data() + i * sizeof(W);
+        out[pos++] = '0';
+        out[pos++] = 'x';
+        for (std::size_t k = 0; k < sizeof(W); k++) {
+            const std::size_t byteindex = order == std::endian::little ? sizeof(W) - 1 - k : k;
+            const std::array<char, 5>& digits = hex_byte_table[static_cast<std::uint8_t>(src[byteindex])];
+            out[pos++] = digits[2];
+            out[pos++] = digits[3];
+        }
+        out[pos++] = ',';
+        if ((i + 1) % words_in_line == 0) {
+            std::memcpy(out.data() + pos, "\n\t\t", HexEncoder::chars_in_line_break);
+            pos += HexEncoder::chars_in_line_break;
+        }
+    }
+}
+
+// Encodes SPIRV words (in given byte order of file) packed by two in uint64 literals: first word
+// in low half, so on little-endian target array has the same bytes as little-endian SPIRV.
+// Odd last word is padded with zero. 32 bytes in line
+void EncodeWordPairLiterals(const std::span<const std::byte> data, const std::endian order, std::string& out) {
+    constexpr std::size_t pairs_in_line = 4;
+    constexpr std::size_t chars_in_pair = 2 * sizeof(std::uint64_t) + 3;
+    const std::size_t words = data.size() / sizeof(std::uint32_t);
+    const std::size_t pairs = (words + 1) / 2;
+    std::size_t pos = out.size();
+    out.resize(pos + pairs * chars_in_pair + (pairs / pairs_in_line) * HexEncoder::chars_in_line_break);
+    for (std::size_t i = 0; i < pairs; i++) {
+        out[pos++] = '0';
+        out[pos++] = 'x';
+        for (std::size_t k = 0; k < sizeof(std::uint64_t); k++) {
+            // Digits go from most significant byte: high word first
+            const std::size_t word = 2 * i + 1 - k / sizeof(std::uint32_t);
+            const std::size_t byteinword = sizeof(std::uint32_t) - 1 - k % sizeof(std::uint32_t);
+            const std::size_t byteindex = word * sizeof(std::uint32_t) +
+                (order == std::endian::little ? byteinword : sizeof(std::uint32_t) - 1 - byteinword);
+            const std::array<char, 5>& digits = hex_byte_table[word < words ?
+                static_cast<std::uint8_t>(data[byteindex]) : 0];
+            out[pos++] = digits[2];
+            out[pos++] = digits[3];
+        }
+        out[pos++] = ',';
+        if ((i + 1) % pairs_in_line == 0) {
+            std::memcpy(out.data() + pos, "\n\t\t", HexEncoder::chars_in_line_break);
+            pos += HexEncoder::chars_in_line_break;
+        }
+    }
+}
+
+// Encodes data as string literals, one literal in line of module. Printable characters are kept,
+// others are written as octal escapes (hex escapes have no length limit, so they can't be followed
+// by digits). Lines are short, so every literal is far below compilers limits
+// MSVC doesn't accept longer concatenated string literal (C2026), terminating zero is included
+constexpr std::size_t max_string_literal_size{ 65535 };
+
+void EncodeStringLiterals(const std::span<const std::byte> data, std::string& out) {
+    constexpr std::size_t chars_in_line = 96;
+    out += '"';
+    std::size_t linestart = out.size();
+    for (std::size_t i = 0; i < data.size(); i++) {
+        const auto value = static_cast<std::uint8_t>(data[i]);
+        if (value >= 0x20 && value < 0x7F && value != '"' && value != '\\') {
+            out += static_cast<char>(value);
+        }
+        else {
+            const bool digitnext = i + 1 < data.size() && out.size() - linestart < chars_in_line &&
+                static_cast<std::uint8_t>(data[i + 1]) >= '0' && static_cast<std::uint8_t>(data[i + 1]) <= '7';
+            out += '\\';
+            if (digitnext || value >= 0100) {
+                out += static_cast<char>('0' + (value >> 6));
+            }
+            if (digitnext || value >= 010) {
+                out += static_cast<char>('0' + ((value >> 3) & 7));
+            }
+            out += static_cast<char>('0' + (value & 7));
+        }
+        if (out.size() - linestart >= chars_in_line && i + 1 < data.size()) {
+            out += "\"\n\t\t\"";
+            linestart = out.size();
+        }
+    }
+    out += '"';
+}
+
+// Block of shader compressed to compact or lz4 format, word count or size tells size of buffer for decoder
+void CompressedShaderBlock(const HexEncoder& encoder, const ArrayFormat format, const BlockLinkage linkage,
+                           const std::string& nameofdata, const std::size_t size,
+                           const std::span<const std::byte> compressed, std::string& block) {
+    // Module array is constexpr, so shader can be decoded in constant evaluation
+    const std::string declaration = (linkage == BlockLinkage::module ? "inline constexpr" : "constinit") +
+        std::string(" std::array<const unsigned char, ") + std::to_string(compressed.size()) + ">";
+    if (linkage == BlockLinkage::module) {
+        block += format == ArrayFormat::compact ?
+            "\texport inline constexpr std::size_t " + nameofdata + "_word_count = " +
+                std::to_string(size / sizeof(std::uint32_t)) + ";\n" :
+            "\texport inline constexpr std::size_t " + nameofdata + "_bytecode_size = " + std::to_string(size) + ";\n";
+    }
+    block += DataArrayHeader(linkage, false, declaration, nameofdata);
+    encoder.Encode(compressed, block);
+    block += shader_array_footer;
+    if (linkage == BlockLinkage::source) {
+        block += SourceSpanDefinition(format, nameofdata, compressed.size());
+    }
+}
+
+// Declaration of bytes array, its data is encoded after it by HexEncoder (in block or straight to output chunk)
+[[nodiscard]] std::string HexArrayHeader(const ArrayFormat format, const BlockLinkage linkage,
+                                         const std::string& nameofdata, const std::size_t size) {
+    if (format == ArrayFormat::string) {
+        spdlog::info("Shader {0} has {1} bytes, it is written as bytes array, because MSVC doesn't accept"
+                     " so long string literal", nameofdata, size);
+    }
+    // Long shader of string format is aligned as short ones
+    return linkage == BlockLinkage::module && format != ArrayFormat::string ? ShaderArrayHeader(nameofdata, size) :
+        DataArrayHeader(linkage, format == ArrayFormat::string, "constinit std::array<const unsigned char, " +
+            std::to_string(size) + ">", nameofdata);
+}
+
+// End of shader array, in source file it is followed by span declared in header
+[[nodiscard]] std::string ShaderArrayFooter(const ArrayFormat format, const BlockLinkage linkage,
+                                            const std::string& nameofdata, const std::size_t size) {
+    return std::string(shader_array_footer) +
+        (linkage == BlockLinkage::source ? SourceSpanDefinition(format, nameofdata, size) : "");
+}
+
+// Makes module text block of shader, for object file formats block is raw shader data
+void EncodeShaderBlock(const HexEncoder& encoder, const ArrayFormat format, const BlockLinkage linkage,
+                       const std::string& nameofdata, const std::span<const std::byte> spvdata, std::string& block) {
+    if (format == ArrayFormat::elf) {
+        block.append(reinterpret_cast<const char*>(spvdata.data()), spvdata.size());
+        return;
+    }
+    if (format == ArrayFormat::u32 || format == ArrayFormat::u64 || format == ArrayFormat::blob) {
+        if (spvdata.size() % sizeof(std::uint32_t) != 0) {
+            throw std::runtime_error("Shader " + nameofdata + " has " + std::to_string(spvdata.size()) +
+                                     " bytes, " + std::string(ArrayFormatName(format)) +
+                                     " array needs size multiple of 4");
+        }
+    }
+    if (format == ArrayFormat::blob) {
+        // Block is part of shader_blob initializer, it ends with line break
+        block += "\t\t// " + nameofdata + "\n\t\t";
+        EncodeWordLiterals<std::uint32_t>(spvdata, SpvByteOrder(spvdata), block);
+        if (block.ends_with("\n\t\t")) {
+            block.resize(block.size() - HexEncoder::chars_in_line_break);
+        }
+        block += '\n';
+        return;
+    }
+    if (format == ArrayFormat::u64) {
+        const std::size_t words = spvdata.size() / sizeof(std::uint32_t);
+        if (linkage == BlockLinkage::module) {
+            block += "\texport inline constexpr std::size_t " + nameofdata + "_word_count = " +
+                std::to_string(words) + ";\n";
+        }
+        block += DataArrayHeader(linkage, false, (linkage == BlockLinkage::module ? "inline " : "") +
+            std::string("constexpr std::array<const std::uint64_t, ") + std::to_string((words + 1) / 2) + ">",
+            nameofdata);
+        EncodeWordPairLiterals(spvdata, SpvByteOrder(spvdata), block);
+    }
+    else if (format == ArrayFormat::u32) {
+        block += DataArrayHeader(linkage, true, "constinit std::array<const std::uint32_t, " +
+            std::to_string(spvdata.size() / sizeof(std::uint32_t)) + ">", nameofdata);
+        EncodeWordLiterals<std::uint32_t>(spvdata, SpvByteOrder(spvdata), block);
+    }
+    else if (format == ArrayFormat::string && spvdata.size() < max_string_literal_size) {
+        // Array is one byte longer than data for terminating zero of literal
+        const std::string size = std::to_string(spvdata.size());
+        block += "\talignas(4) " + std::string(linkage == BlockLinkage::module ? "inline" : "static") +
+            " constexpr unsigned char " + nameofdata + "_bytecode_data[" + size + " + 1]\n\t{\n\t\t";
+        EncodeStringLiterals(spvdata, block);
+        block += shader_array_footer;
+        block += (linkage == BlockLinkage::module ? "\texport inline constexpr std::span<const unsigned char, " :
+            "\tconst std::span<const unsigned char, ") + size + "> " + nameofdata +
+            "_bytecode{ " + nameofdata + "_bytecode_data, " + size + " };\n";
+        return;
+    }
+    else {
+        block += HexArrayHeader(format, linkage, nameofdata, spvdata.size());
+        encoder.Encode(spvdata, block);
+    }
+    block += ShaderArrayFooter(format, linkage, nameofdata, spvdata.size());
+}
+
+// Block of module shader which has the same data as original shader, it is span of data of original
+void AliasShaderBlock(const ArrayFormat format, const std::string& nameofdata, const std::string& original,
+                      const std::uintmax_t size, std::string& block) {
+    block += "\texport inline constexpr " + ShaderSpanType(format, size) + " " + nameofdata + "_bytecode{ " +
+        original + "_bytecode };\n";
+    std::string_view constant;
+    if (format == ArrayFormat::u64 || format == ArrayFormat::compact) {
+        constant = "_word_count";
+    }
+    else if (format == ArrayFormat::lz4) {
+        constant = "_bytecode_size";
+    }
+    if (!constant.empty()) {
+        block += "\texport inline constexpr std::size_t " + nameofdata + std::string(constant) + " = " +
+            original + std::string(constant) + ";\n";
+    }
+}
+
+// Makes module text block of one shader: produce(index, reader, block) returns false for skipped file
+using ShaderBlockProducer = std::function<bool(std::size_t, SpvFileReader&, std::string&)>;
+
+// Produces shader blocks on worker threads and gives them back in order of files list.
+// Blocks waiting for consumer are limited by number and by estimated bytes (costs), so memory stays
+// bounded with any number of jobs: block over budget is made only when it is the next to consume
+class ShaderEncodePool final {
+public:
+    static constexpr std::uintmax_t bytes_budget = 64 * 1024 * 1024;
+
+    explicit ShaderEncodePool(const std::size_t count, const unsigned jobs, ShaderBlockProducer produce,
+                              std::vector<std::uintmax_t> costs = {})
+        : m_count(count), m_jobs(jobs), m_slots(2 * static_cast<std::size_t>(jobs)), m_produce(std::move(produce)),
+          m_costs(std::move(costs)) {}
+
+    ShaderEncodePool(const ShaderEncodePool&) = delete;
+    ShaderEncodePool(const ShaderEncodePool&&) = delete;
+    ShaderEncodePool& operator=(const ShaderEncodePool&) = delete;
+    ShaderEncodePool& operator=(const ShaderEncodePool&&) = delete;
+
+    // consume(index, block) is called on current thread in order of files,
+    // skipped (unreadable) files are not passed
+    template<typename F>
+    void ForEachInOrder(F&& consume) {
+        std::vector<std::jthread> workers;
+        workers.reserve(m_jobs);
+        for (unsigned i = 0; i < m_jobs; i++) {
+            workers.emplace_back([this] { WorkerLoop(); });
+        }
+
+        try {
+            for (std::size_t index = 0; index < m_count; index++) {
+                Slot& slot = m_slots[index % m_slots.size()];
+                {
+                    std::unique_lock lock(m_mutex);
+                    m_ready_cv.wait(lock, [&] { return slot.ready || m_error; });
+                    if (m_error) {
+                        break;
+                    }
+                }
+                if (slot.ok) {
+                    consume(index, std::string_view(slot.text));
+                }
+                // Memory of block is given back, next block of slot can be much smaller
+                const std::size_t held = slot.text.capacity();
+                std::string().swap(slot.text);
+                {
+                    std::lock_guard lock(m_mutex);
+                    slot.ready = false;
+                    m_consumed++;
+                    m_admitted_bytes -= Cost(index);
+                    m_held_bytes -= held;
+                }
+                m_free_cv.notify_all();
+            }
+        }
+        catch (...) {
+            Cancel();
+            throw;
+        }
+        Cancel();
+        workers.clear();
+        if (m_error) {
+            std::rethrow_exception(m_error);
+        }
+    }
+
+    // Peak size of blocks held by pool at once
+    _ALWAYS_INLINE std::size_t GetPeakHeldBytes() const noexcept {
+        return m_peak_held_bytes;
+    }
+
+private:
+    struct Slot {
+        std::string text;
+        bool ready{ false };
+        bool ok{ false };
+    };
+
+    [[nodiscard]] std::uintmax_t Cost(const std::size_t index) const noexcept {
+        return m_costs.empty() ? 0 : m_costs[index];
+    }
+
+    void Cancel() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_cancelled = true;
+        }
+        m_free_cv.notify_all();
+    }
+
+    void WorkerLoop() {
+        SpvFileReader reader;
+        while (true) {
+            std::size_t index{ 0 };
+            {
+                std::unique_lock lock(m_mutex);
+                if (m_next == m_count || m_cancelled) {
+                    return;
+                }
+                index = m_next++;
+                m_free_cv.wait(lock, [&] {
+                    return m_cancelled || (index < m_consumed + m_slots.size() &&
+                        (index == m_consumed || m_admitted_bytes + Cost(index) <= bytes_budget));
+                });
+                if (m_cancelled) {
+                    return;
+                }
+                m_admitted_bytes += Cost(index);
+            }
+
+            Slot& slot = m_slots[index % m_slots.size()];
+            try {
+                slot.text.clear();
+                slot.ok = m_produce(index, reader, slot.text);
+            }
+            catch (...) {
+                std::lock_guard lock(m_mutex);
+                if (!m_error) {
+                    m_error = std::current_exception();
+                }
+                m_cancelled = true;
+                m_ready_cv.notify_all();
+                m_free_cv.notify_all();
+                return;
+            }
+            {
+                std::lock_guard lock(m_mutex);
+                slot.ready = true;
+                m_held_bytes += slot.text.capacity();
+                m_peak_held_bytes = std::max(m_peak_held_bytes, m_held_bytes);
+            }
+            m_ready_cv.notify_all();
+        }
+    }
+
+    const std::size_t m_count;
+    const unsigned m_jobs;
+    std::vector<Slot> m_slots;
+    ShaderBlockProducer m_produce;
+    const std::vector<std::uintmax_t> m_costs;
+    std::mutex m_mutex;
+    std::condition_variable m_ready_cv;
+    std::condition_variable m_free_cv;
+    std::size_t m_next{ 0 };
+    std::size_t m_consumed{ 0 };
+    std::uintmax_t m_admitted_bytes{ 0 };
+    std::size_t m_held_bytes{ 0 };
+    std::size_t m_peak_held_bytes{ 0 };
+    bool m_cancelled{ false };
+    std::exception_ptr m_error;
+};
+
+// Runs inspect(index, data) for every readable .spv file on threads of pool, before any block is made
+void InspectSpvFiles(const std::vector<SpvInput>& spvfiles, const unsigned jobs,
+                     const std::function<void(std::size_t, std::span<const std::byte>)>& inspect) {
+    ShaderEncodePool pool(spvfiles.size(), jobs,
+        [&](const std::size_t index, SpvFileReader& reader, std::string&) {
+            const std::optional<std::span<const std::byte>> spvdata = reader.Open(spvfiles[index].path);
+            if (!spvdata.has_value()) {
+                return false;
+            }
+            inspect(index, spvdata.value());
+            return true;
+        });
+    pool.ForEachInOrder([](const std::size_t, const std::string_view) {});
+}
+
+// Checks all files on threads of pool before any output is written, invalid files fail run
+void ValidateSpvFiles(const std::vector<SpvInput>& spvfiles, const unsigned jobs) {
+    // File which can't be opened or read isn't inspected and keeps its problem
+    std::vector<std::optional<std::string>> problems(spvfiles.size(), "file can't be opened or read");
+    InspectSpvFiles(spvfiles, jobs, [&](const std::size_t index, const std::span<const std::byte> spvdata) {
+        problems[index] = ValidateSpvModule(spvdata);
+    });
+    std::string invalidfiles;
+    std::size_t invalidcount{ 0 };
+    for (std::size_t i = 0; i < spvfiles.size(); i++) {
+        if (problems[i].has_value()) {
+            const std::string filename = Utf8PathString(spvfiles[i].path.filename());
+            spdlog::error("SPIRV file {0} is not valid: {1}", filename, problems[i].value());
+            invalidfiles += invalidfiles.empty() ? filename : ", " + filename;
+            invalidcount++;
+        }
+    }
+    if (invalidcount > 0) {
+        throw std::runtime_error(std::to_string(invalidcount) + " of " + std::to_string(spvfiles.size()) +
+                                 " SPIRV files are not valid: " + invalidfiles);
+    }
+}
+
+// Which shaders are the same for deduplication
+enum class DedupMode {
+    bytes,
+    debug   // Shaders which differ only by debug info
+};
+
+template<typename S>
+    requires requires {
+    std::is_same<S, std::string>::value || std::is_same<S, std::wstring>::value;
+}
+[[nodiscard]] DedupMode ParseDedupMode(const std::deque<S>& values) {
+    if (values.size() == 1) {
+        if (values.front() == S{ 'b', 'y', 't', 'e', 's' }) {
+            return DedupMode::bytes;
+        }
+        if (values.front() == S{ 'd', 'e', 'b', 'u', 'g' }) {
+            return DedupMode::debug;
+        }
+    }
+    throw std::runtime_error("-dedup must be bytes or debug");
+}
+
+// Data which is compared for deduplication, in debug mode it is module without debug info
+[[nodiscard]] std::span<const std::byte> DedupData(const std::span<const std::byte> data, const DedupMode mode,
+                                                   std::vector<std::byte>& stripped) {
+    if (mode == DedupMode::debug &&
+        StripSpvModule(data, SpvStripOptions{ .names = true, .lines = true, .source = true }, stripped)) {
+        return stripped;
+    }
+    return data;
+}
+
+// Gives index of original for every shader: first shader with the same data or shader itself.
+// Files are hashed on threads, then shaders with hash of earlier shader are compared with them on threads,
+// so collision doesn't join different shaders
+[[nodiscard]] std::vector<std::size_t> FindDuplicateShaders(const std::vector<SpvInput>& spvfiles, const unsigned jobs,
+                                                            const DedupMode mode) {
+    std::vector<std::optional<std::uint64_t>> hashes(spvfiles.size());
+    InspectSpvFiles(spvfiles, jobs, [&](const std::size_t index, const std::span<const std::byte> spvdata) {
+        std::vector<std::byte> stripped;
+        hashes[index] = Hash64(DedupData(spvdata, mode, stripped));
+    });
+
+    // Earlier shaders with the same hash are candidates for original, in order of names
+    std::vector<std::size_t> originals(spvfiles.size());
+    std::vector<std::vector<std::size_t>> candidates(spvfiles.size());
+    std::unordered_map<std::uint64_t, std::vector<std::size_t>> groups;
+    std::vector<SpvInput> checkedfiles;
+    std::vector<std::size_t> checkedindices;
+    for (std::size_t i = 0; i < spvfiles.size(); i++) {
+        originals[i] = i;
+        if (!hashes[i].has_value()) {
+            continue;
+        }
+        std::vector<std::size_t>& group = groups[hashes[i].value()];
+        if (!group.empty()) {
+            candidates[i] = group;
+            checkedfiles.push_back(spvfiles[i]);
+            checkedindices.push_back(i);
+        }
+        group.push_back(i);
+    }
+
+    // Equal data is transitive, so first equal candidate is original of every shader of group
+    InspectSpvFiles(checkedfiles, jobs, [&](const std::size_t checked, const std::span<const std::byte> spvdata) {
+        const std::size_t index = checkedindices[checked];
+        std::vector<std::byte> stripped;
+        const std::span<const std::byte> compared = DedupData(spvdata, mode, stripped);
+        SpvFileReader candidatereader;
+        for (const std::size_t candidate : candidates[index]) {
+            const std::optional<std::span<const std::byte>> candidatedata = candidatereader.Open(spvfiles[candidate].path);
+            std::vector<std::byte> candidatestripped;
+            if (candidatedata.has_value() &&
+                std::ranges::equal(compared, DedupData(candidatedata.value(), mode, candidatestripped))) {
+                originals[index] = candidate;
+                return;
+            }
+        }
+    });
+    return originals;
+}
+
+// Size, modification time and content hash of .spv file
+struct SpvFileStamp {
+    std::uint64_t size{ 0 };
+    std::int64_t mtime{ 0 };
+    std::uint64_t hash{ 0 };
+};
+
+// State of previous incremental generation: stamp and module text block of every .spv file.
+// File has text signature line and then binary records in native byte order
+class ModuleState final {
+public:
+    struct Entry {
+        SpvFileStamp stamp;
+        std::uint64_t datasize{ 0 };
+        std::string_view block;
+    };
+
+    explicit ModuleState() = default;
+
+    ModuleState(const ModuleState&) = delete;
+    ModuleState(const ModuleState&&) = delete;
+    ModuleState& operator=(const ModuleState&) = delete;
+    ModuleState& operator=(const ModuleState&&) = delete;
+
+    [[nodiscard]] static std::string Signature(const std::string_view format) {
+        return "spv2headerconv state 2 " + std::string(format) + "\n";
+    }
+
+    // Missing or damaged state is treated as empty
+    void Load(const std::filesystem::path& filepath, const std::string_view format) {
+        m_entries.clear();
+        std::error_code ec;
+        if (!std::filesystem::exists(filepath, ec)) {
+            return;
+        }
+        const std::optional<std::span<const std::byte>> data = m_reader.Open(filepath);
+        if (!data.has_value()) {
+            return;
+        }
+        const std::string_view text(reinterpret_cast<const char*>(data->data()), data->size());
+        const std::string signature = Signature(format);
+        if (!text.starts_with(signature)) {
+            spdlog::info("Incremental state {0} has other format and is not used", filepath.string());
+            return;
+        }
+        std::size_t pos = signature.size();
+        const auto read = [&](void* value, const std::size_t size) {
+            if (text.size() - pos < size) {
+                return false;
+            }
+            std::memcpy(value, text.data() + pos, size);
+            pos += size;
+            return true;
+        };
+        while (pos < text.size()) {
+            std::uint64_t namesize{ 0 };
+            std::uint64_t blocksize{ 0 };
+            Entry entry;
+            if (!read(&namesize, sizeof namesize) || text.size() - pos < namesize) {
+                break;
+            }
+            const std::string_view name = text.substr(pos, namesize);
+            pos += namesize;
+            if (!read(&entry.stamp.size, sizeof entry.stamp.size) ||
+                !read(&entry.stamp.mtime, sizeof entry.stamp.mtime) ||
+                !read(&entry.stamp.hash, sizeof entry.stamp.hash) ||
+                !read(&entry.datasize, sizeof entry.datasize) ||
+                !read(&blocksize, sizeof blocksize) || text.size() - pos < blocksize) {
+                break;
+            }
+            entry.block = text.substr(pos, blocksize);
+            pos += blocksize;
+            m_entries.emplace(std::string(name), entry);
+        }
+        if (pos != text.size()) {
+            spdlog::warn("Incremental state {0} is damaged and is not used", filepath.string());
+            m_entries.clear();
+        }
     }
-    catch (const std::ios_base::failure& ex) {
-        spdlog::critical("Unable to create stream for writing"
-                        " ixx file with error {0}", ex.what());
+
+    // Unmaps previous state, so it can be replaced
+    void Close() noexcept {
+        m_entries.clear();
+        m_reader.Close();
+    }
+
+    [[nodiscard]] const Entry* Find(const std::string& name) const {
+        const auto it = m_entries.find(name);
+        return it == m_entries.end() ? nullptr : &it->second;
+    }
+
+    // Data size is size of shader data in block, it differs from file size when debug info is stripped
+    static void WriteEntry(ModuleWriter& writer, const std::string& name, const SpvFileStamp& stamp,
+                           const std::uint64_t datasize, const std::string_view block) {
+        const std::uint64_t namesize = name.size();
+        const std::uint64_t blocksize = block.size();
+        writer.Write(std::string_view(reinterpret_cast<const char*>(&namesize), sizeof namesize));
+        writer.Write(name);
+        writer.Write(std::string_view(reinterpret_cast<const char*>(&stamp.size), sizeof stamp.size));
+        writer.Write(std::string_view(reinterpret_cast<const char*>(&stamp.mtime), sizeof stamp.mtime));
+        writer.Write(std::string_view(reinterpret_cast<const char*>(&stamp.hash), sizeof stamp.hash));
+        writer.Write(std::string_view(reinterpret_cast<const char*>(&datasize), sizeof datasize));
+        writer.Write(std::string_view(reinterpret_cast<const char*>(&blocksize), sizeof blocksize));
+        writer.Write(block);
+    }
+
+private:
+    SpvFileReader m_reader;
+    std::unordered_map<std::string, Entry> m_entries;
+};
+
+[[nodiscard]] bool IsSameFileContent(const std::filesystem::path& first, const std::filesystem::path& second) {
+    std::error_code ec;
+    const std::uintmax_t firstsize = std::filesystem::file_size(first, ec);
+    if (ec || firstsize != std::filesystem::file_size(second, ec) || ec) {
+        return false;
+    }
+    std::ifstream firstfile{ first, std::ios::in | std::ios::binary };
+    std::ifstream secondfile{ second, std::ios::in | std::ios::binary };
+    std::vector<char> firstbuf(ModuleWriter::chunk_size);
+    std::vector<char> secondbuf(ModuleWriter::chunk_size);
+    while (firstfile && secondfile) {
+        firstfile.read(firstbuf.data(), firstbuf.size());
+        secondfile.read(secondbuf.data(), secondbuf.size());
+        if (firstfile.gcount() != secondfile.gcount() ||
+            std::memcmp(firstbuf.data(), secondbuf.data(), static_cast<std::size_t>(firstfile.gcount())) != 0) {
+            return false;
+        }
+    }
+    return firstfile.eof() && secondfile.eof();
+}
+
+// Moves temp file over target only if contents differ, so target keeps its
+// modification time when nothing changed. Returns true if target was replaced
+bool ReplaceFileIfChanged(const std::filesystem::path& temp, const std::filesystem::path& target) {
+    if (IsSameFileContent(temp, target)) {
+        std::filesystem::remove(temp);
+        return false;
+    }
+    std::filesystem::rename(temp, target);
+    return true;
+}
+
+[[nodiscard]] std::filesystem::path TempPathFor(const std::filesystem::path& target) {
+    std::filesystem::path temp = target;
+    temp += ".tmp";
+    return temp;
+}
+
+// Makes array block which takes shader data with #embed from file instead of hex literals.
+// Hash of content is added as comment, so module is changed when shader is changed
+void EmbedShaderBlock(const BlockLinkage linkage, const std::string& nameofdata, const std::filesystem::path& embedpath,
+                      const std::span<const std::byte> spvdata, std::string& block) {
+    std::string quotedpath;
+    for (const char c : Utf8PathString(embedpath)) {
+        if (c == '"' || c == '\\') {
+            quotedpath += '\\';
+        }
+        quotedpath += c;
+    }
+    block += linkage == BlockLinkage::module ? ShaderArrayHeader(nameofdata, spvdata.size()) :
+        DataArrayHeader(linkage, false, "constinit std::array<const unsigned char, " +
+            std::to_string(spvdata.size()) + ">", nameofdata);
+    block += "#embed \"" + quotedpath + "\" // xxh64 " + HashToHex(Hash64(spvdata));
+    block += shader_array_footer;
+    if (linkage == BlockLinkage::source) {
+        block += SourceSpanDefinition(ArrayFormat::embed, nameofdata, spvdata.size());
+    }
+}
+
+// Preamble of assembler file, it must be preprocessed (.S) to pick section and symbol names of target
+constexpr std::string_view assembly_preamble{
+    "#if defined(__APPLE__)\n"
+    "#define SPV_SYMBOL(name) _##name\n"
+    "\t.const\n"
+    "#elif defined(_WIN32)\n"
+    "#define SPV_SYMBOL(name) name\n"
+    "\t.section .rdata,\"dr\"\n"
+    "#else\n"
+    "#define SPV_SYMBOL(name) name\n"
+    "\t.section .rodata\n"
+    "#endif\n"
+    "#if defined(__ELF__)\n"
+    "#define SPV_OBJECT(symbol, bytes) .type symbol, %object; .size symbol, bytes\n"
+    "#else\n"
+    "#define SPV_OBJECT(symbol, bytes)\n"
+    "#endif\n\n" };
+
+constexpr std::string_view assembly_footer{
+    "\n#if defined(__ELF__)\n"
+    "\t.section .note.GNU-stack,\"\",%progbits\n"
+    "#endif\n" };
+
+// Makes assembler block with .incbin of shader file. Hash of content is added as comment,
+// so file is changed and reassembled when shader is changed without changing its size
+void AssemblyShaderBlock(const std::string& nameofdata, const std::filesystem::path& incbinpath,
+                         const std::span<const std::byte> spvdata, std::string& block) {
+    std::string quotedpath;
+    for (const char c : Utf8PathString(incbinpath)) {
+        if (c == '"' || c == '\\') {
+            quotedpath += '\\';
+        }
+        quotedpath += c;
+    }
+    const std::string symbol = "SPV_SYMBOL(shader_spv_" + nameofdata + "_bytecode)";
+    const std::string sizesymbol = "SPV_SYMBOL(shader_spv_" + nameofdata + "_bytecode_size)";
+    const std::string size = std::to_string(spvdata.size());
+    block += "\t.balign 16\n\t.global " + symbol + "\n\tSPV_OBJECT(" + symbol + ", " + size + ")\n";
+    block += symbol + ":\n\t.incbin \"" + quotedpath + "\" /* xxh64 " + HashToHex(Hash64(spvdata)) + " */\n";
+    block += "\t.balign 8\n\t.global " + sizesymbol + "\n\tSPV_OBJECT(" + sizesymbol + ", 8)\n";
+    block += sizesymbol + ":\n\t.quad " + size + "\n\n";
+}
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+constexpr std::uint16_t elf_machine = 183;
+#else
+constexpr std::uint16_t elf_machine = 62;
+#endif
+
+template<typename T>
+void AppendLittle(std::string& out, const T value) {
+    for (std::size_t i = 0; i < sizeof(T); i++) {
+        out += static_cast<char>((static_cast<std::uint64_t>(value) >> (8 * i)) & 0xFF);
+    }
+}
+
+// Writes relocatable little-endian ELF64 object for host machine (x86-64 or AArch64).
+// Every shader is placed to .rodata with global symbols <symbol> for data and
+// <symbol>_size for 64-bit size of data
+class ElfObjectWriter final {
+public:
+    static constexpr std::size_t data_alignment = 16;
+
+    explicit ElfObjectWriter(const std::filesystem::path& filepath) : m_writer(filepath) {
+        m_writer.Write(std::string(elf_header_size, '\0'));
+        m_strtab += '\0';
+    }
+
+    ElfObjectWriter(const ElfObjectWriter&) = delete;
+    ElfObjectWriter(const ElfObjectWriter&&) = delete;
+    ElfObjectWriter& operator=(const ElfObjectWriter&) = delete;
+    ElfObjectWriter& operator=(const ElfObjectWriter&&) = delete;
+
+    void Add(const std::string& symbol, const std::string_view data) {
+        Pad(data_alignment);
+        AddSymbol(symbol, m_offset - elf_header_size, data.size());
+        m_sizes.emplace_back(symbol + "_size", data.size());
+        m_writer.Write(data);
+        m_offset += data.size();
+    }
+
+    void Close() {
+        Pad(sizeof(std::uint64_t));
+        for (const auto& [symbol, size] : m_sizes) {
+            AddSymbol(symbol, m_offset - elf_header_size, sizeof(std::uint64_t));
+            std::string value;
+            AppendLittle<std::uint64_t>(value, size);
+            WriteRaw(value);
+        }
+        const std::uint64_t rodatasize = m_offset - elf_header_size;
+
+        std::string symtab(symbol_size, '\0');
+        for (const Symbol& symbol : m_symbols) {
+            AppendLittle<std::uint32_t>(symtab, symbol.name);
+            symtab += static_cast<char>(0x11);
+            symtab += '\0';
+            AppendLittle<std::uint16_t>(symtab, 1);
+            AppendLittle<std::uint64_t>(symtab, symbol.value);
+            AppendLittle<std::uint64_t>(symtab, symbol.size);
+        }
+        const std::uint64_t symtaboffset = m_offset;
+        WriteRaw(symtab);
+        const std::uint64_t strtaboffset = m_offset;
+        WriteRaw(m_strtab);
+        constexpr std::string_view shstrtab{ "\0.rodata\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack\0", 52 };
+        const std::uint64_t shstrtaboffset = m_offset;
+        WriteRaw(shstrtab);
+        Pad(sizeof(std::uint64_t));
+
+        const std::uint64_t sectionsoffset = m_offset;
+        std::string sections(section_header_size, '\0');
+        AppendSection(sections, 1, 1, 2, elf_header_size, rodatasize, 0, 0, data_alignment, 0);
+        AppendSection(sections, 9, 2, 0, symtaboffset, symtab.size(), 3, 1, 8, symbol_size);
+        AppendSection(sections, 17, 3, 0, strtaboffset, m_strtab.size(), 0, 0, 1, 0);
+        AppendSection(sections, 25, 3, 0, shstrtaboffset, shstrtab.size(), 0, 0, 1, 0);
+        AppendSection(sections, 35, 1, 0, sectionsoffset, 0, 0, 0, 1, 0);
+        WriteRaw(sections);
+
+        std::string header{ "\x7f" "ELF\x02\x01\x01", 7 };
+        header.resize(16, '\0');
+        AppendLittle<std::uint16_t>(header, 1);
+        AppendLittle<std::uint16_t>(header, elf_machine);
+        AppendLittle<std::uint32_t>(header, 1);
+        AppendLittle<std::uint64_t>(header, 0);
+        AppendLittle<std::uint64_t>(header, 0);
+        AppendLittle<std::uint64_t>(header, sectionsoffset);
+        AppendLittle<std::uint32_t>(header, 0);
+        AppendLittle<std::uint16_t>(header, elf_header_size);
+        AppendLittle<std::uint16_t>(header, 0);
+        AppendLittle<std::uint16_t>(header, 0);
+        AppendLittle<std::uint16_t>(header, section_header_size);
+        AppendLittle<std::uint16_t>(header, 6);
+        AppendLittle<std::uint16_t>(header, 4);
+        m_writer.Rewrite(0, header);
+        m_writer.Close();
+    }
+
+    _ALWAYS_INLINE std::uint64_t GetWrittenSize() const noexcept {
+        return m_offset;
+    }
+
+    _ALWAYS_INLINE std::size_t GetPeakBufferUsage() const noexcept {
+        return m_writer.GetPeakBufferUsage();
+    }
+
+private:
+    static constexpr std::uint16_t elf_header_size = 64;
+    static constexpr std::uint16_t section_header_size = 64;
+    static constexpr std::size_t symbol_size = 24;
+
+    struct Symbol {
+        std::uint32_t name;
+        std::uint64_t value;
+        std::uint64_t size;
+    };
+
+    static void AppendSection(std::string& out, const std::uint32_t name, const std::uint32_t type,
+                              const std::uint64_t flags, const std::uint64_t offset, const std::uint64_t size,
+                              const std::uint32_t link, const std::uint32_t info,
+                              const std::uint64_t align, const std::uint64_t entsize) {
+        AppendLittle<std::uint32_t>(out, name);
+        AppendLittle<std::uint32_t>(out, type);
+        AppendLittle<std::uint64_t>(out, flags);
+        AppendLittle<std::uint64_t>(out, 0);
+        AppendLittle<std::uint64_t>(out, offset);
+        AppendLittle<std::uint64_t>(out, size);
+        AppendLittle<std::uint32_t>(out, link);
+        AppendLittle<std::uint32_t>(out, info);
+        AppendLittle<std::uint64_t>(out, align);
+        AppendLittle<std::uint64_t>(out, entsize);
+    }
+
+    void AddSymbol(const std::string& symbol, const std::uint64_t value, const std::uint64_t size) {
+        m_symbols.emplace_back(Symbol{ static_cast<std::uint32_t>(m_strtab.size()), value, size });
+        m_strtab += symbol;
+        m_strtab += '\0';
+    }
+
+    void Pad(const std::size_t alignment) {
+        const std::size_t padding = (alignment - m_offset % alignment) % alignment;
+        WriteRaw(std::string(padding, '\0'));
+    }
+
+    void WriteRaw(const std::string_view data) {
+        m_writer.Write(data);
+        m_offset += data.size();
+    }
+
+    ModuleWriter m_writer;
+    std::uint64_t m_offset{ elf_header_size };
+    std::string m_strtab;
+    std::vector<Symbol> m_symbols;
+    std::vector<std::pair<std::string, std::uint64_t>> m_sizes;
+};
+
+// Writes small module file through temporary file, gives true if file is changed
+bool WriteModuleIfChanged(const std::filesystem::path& filepath, const std::string_view text) {
+    ModuleWriter writer(TempPathFor(filepath));
+    writer.Write(text);
+    writer.Close();
+    return ReplaceFileIfChanged(TempPathFor(filepath), filepath);
+}
+
+// Removes files of directory named <prefix><something><suffix> (something is number if numbered) which aren't
+// kept. They are left from previous run with other shaders or commands, and build which compiles all files
+// of directory would still get them
+void RemoveStaleFiles(const std::filesystem::path& directory, const std::string_view prefix,
+                      const std::string_view suffix, const std::unordered_set<std::string>& kept,
+                      const bool numbered = false) {
+    std::vector<std::filesystem::path> stale;
+    std::error_code ec;
+    for (auto it = std::filesystem::directory_iterator(directory, ec);
+         !ec && it != std::filesystem::directory_iterator(); it.increment(ec)) {
+        std::error_code entryec;
+        const std::string filename = Utf8PathString(it->path().filename());
+        if (!it->is_regular_file(entryec) || filename.size() <= prefix.size() + suffix.size() ||
+            !filename.starts_with(prefix) || !filename.ends_with(suffix) || kept.contains(filename)) {
+            continue;
+        }
+        const std::string_view middle = std::string_view(filename).substr(prefix.size(),
+                                                                          filename.size() - prefix.size() - suffix.size());
+        if (!numbered || std::all_of(middle.begin(), middle.end(), [](const char c) { return c >= '0' && c <= '9'; })) {
+            stale.push_back(it->path());
+        }
+    }
+    std::sort(stale.begin(), stale.end());
+    for (const std::filesystem::path& path : stale) {
+        if (std::filesystem::remove(path, ec)) {
+            spdlog::info("Stale file {0} is removed", Utf8PathString(path.filename()));
+        }
+    }
+}
+
+// Escapes path for Makefile/Ninja depfile
+[[nodiscard]] std::string EscapeDepfilePath(const std::filesystem::path& filepath) {
+    std::string escaped;
+    for (const char c : filepath.string()) {
+        if (c == ' ' || c == '#') {
+            escaped += '\\';
+        }
+        else if (c == '$') {
+            escaped += '$';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+// Writes Makefile style depfile: target depends on all inputs.
+// With relative flag inputs are written relative to current directory
+void WriteDepfile(const std::filesystem::path& depfilepath, const std::filesystem::path& target,
+                  const std::vector<SpvInput>& inputs, const bool relative) {
+    std::string text = EscapeDepfilePath(target) + ":";
+    for (const SpvInput& input : inputs) {
+        text += " \\\n  " + EscapeDepfilePath(relative ?
+            input.path.lexically_relative(std::filesystem::current_path()) : input.path);
+    }
+    text += "\n";
+    ModuleWriter writer(TempPathFor(depfilepath));
+    writer.Write(text);
+    writer.Close();
+    ReplaceFileIfChanged(TempPathFor(depfilepath), depfilepath);
+}
+
+// Spreads shaders to count shards with close total sizes: biggest shader goes to least filled shard.
+// Equal sizes and fills are resolved by index, so the same sizes give the same shards
+[[nodiscard]] std::vector<std::size_t> AssignShards(const std::vector<std::uintmax_t>& sizes, const std::size_t count) {
+    std::vector<std::size_t> order(sizes.size());
+    for (std::size_t i = 0; i < order.size(); i++) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&sizes](const std::size_t a, const std::size_t b) { return sizes[a] > sizes[b]; });
+    std::vector<std::uintmax_t> fills(count, 0);
+    std::vector<std::size_t> shards(sizes.size(), 0);
+    for (const std::size_t index : order) {
+        const std::size_t shard = static_cast<std::size_t>(std::min_element(fills.begin(), fills.end()) - fills.begin());
+        shards[index] = shard;
+        fills[shard] += sizes[index];
+    }
+    return shards;
+}
+
+// Size of text block of shader in format without encoding it, string literals size is average one
+[[nodiscard]] std::uintmax_t EstimatedBlockSize(const ArrayFormat format, const std::uintmax_t size) noexcept {
+    constexpr std::uintmax_t block_declaration_size = 128;
+    const std::uintmax_t words = size / sizeof(std::uint32_t);
+    switch (format) {
+    case ArrayFormat::u32:
+        return block_declaration_size + words * (2 * sizeof(std::uint32_t) + 3);
+    case ArrayFormat::u64:
+        return block_declaration_size + (words + 1) / 2 * (2 * sizeof(std::uint64_t) + 3);
+    case ArrayFormat::string:
+        return size < max_string_literal_size ? block_declaration_size + size * 5 / 2 :
+            block_declaration_size + HexEncoder::EncodedSize(static_cast<std::size_t>(size));
+    case ArrayFormat::embed:
+    case ArrayFormat::assembly:
+        return block_declaration_size;
+    case ArrayFormat::elf:
+        return size;
+    case ArrayFormat::compact:
+        return block_declaration_size + HexEncoder::EncodedSize(static_cast<std::size_t>(size / 3));
+    case ArrayFormat::lz4:
+        return block_declaration_size + HexEncoder::EncodedSize(static_cast<std::size_t>(size / 2));
+    default:
+        return block_declaration_size + HexEncoder::EncodedSize(static_cast<std::size_t>(size));
+    }
+}
+
+// Splits shaders in order of names to shards of about target bytes of text. Shard is closed when it is full
+// or when it is at least half full and name of its last shader is anchor (by hash of name), so change
+// of one shader moves borders only near it and other shards stay the same
+[[nodiscard]] std::vector<std::size_t> PackShards(const std::vector<SpvInput>& inputs,
+                                                  const std::vector<std::uintmax_t>& sizes,
+                                                  const std::uintmax_t target) {
+    constexpr std::uint64_t anchor_period = 4;
+    std::vector<std::size_t> shards(inputs.size(), 0);
+    std::size_t shard{ 0 };
+    std::uintmax_t fill{ 0 };
+    for (std::size_t i = 0; i < inputs.size(); i++) {
+        shards[i] = shard;
+        fill += sizes[i];
+        const std::string& name = inputs[i].name;
+        const bool anchor = Hash64(std::as_bytes(std::span(name.data(), name.size()))) % anchor_period == 0;
+        if (fill >= target || (anchor && fill >= target / 2)) {
+            shard++;
+            fill = 0;
+        }
+    }
+    return shards;
+}
+
+struct ModuleOptions {
+    std::optional<std::filesystem::path> save_module_path{};
+    unsigned jobs{ 1 };
+    bool incremental{ false };
+    bool reproducible{ false };
+    ArrayFormat format{ ArrayFormat::bytes };
+    std::optional<std::filesystem::path> depfile_path{};
+    bool partitions{ false };
+    bool header{ false };
+    std::size_t shards{ 1 };
+    std::optional<std::uintmax_t> shard_bytes{};
+    std::optional<SpvStripOptions> strip{};
+    std::optional<DedupMode> dedup{};
+};
+
+// Encodes already read shader with index to block
+using ShaderBlockEncoder = std::function<void(std::size_t, std::span<const std::byte>, std::string&)>;
+
+// Produces blocks on pool taking blocks of unchanged files from previous state, then saves new state.
+// Peak size of blocks held by pool is written to peakheldbytes
+std::size_t ProduceBlocksIncremental(const std::vector<SpvInput>& spvfiles, const unsigned jobs,
+                                     const std::filesystem::path& statepath, const std::string_view stateformat,
+                                     std::vector<std::uintmax_t>& datasizes, const ShaderBlockEncoder& encode,
+                                     const std::function<void(std::size_t, std::string_view)>& consume,
+                                     std::vector<std::uintmax_t> costs, std::size_t& peakheldbytes) {
+    ModuleState previous;
+    previous.Load(statepath, stateformat);
+    std::vector<SpvFileStamp> stamps(spvfiles.size());
+    std::atomic<std::size_t> reused{ 0 };
+
+    ModuleWriter statewriter(TempPathFor(statepath));
+    statewriter.Write(ModuleState::Signature(stateformat));
+
+    ShaderEncodePool pool(spvfiles.size(), jobs,
+        [&](const std::size_t index, SpvFileReader& reader, std::string& block) {
+            const std::filesystem::path& filepath = spvfiles[index].path;
+            SpvFileStamp& stamp = stamps[index];
+            const ModuleState::Entry* entry = previous.Find(Utf8PathString(filepath.filename()));
+            std::error_code ec;
+            stamp.size = std::filesystem::file_size(filepath, ec);
+            if (!ec) {
+                stamp.mtime = std::filesystem::last_write_time(filepath, ec).time_since_epoch().count();
+            }
+            // Duplicate of other shader has empty block, it is made again, because original can be changed
+            if (!ec && entry && !entry->block.empty() && entry->stamp.size == stamp.size &&
+                entry->stamp.mtime == stamp.mtime) {
+                stamp.hash = entry->stamp.hash;
+                datasizes[index] = entry->datasize;
+                block.assign(entry->block);
+                reused++;
+                return true;
+            }
+
+            const std::optional<std::span<const std::byte>> spvdata = reader.Open(filepath);
+            if (!spvdata.has_value()) {
+                return false;
+            }
+            stamp.size = spvdata->size();
+            stamp.hash = Hash64(spvdata.value());
+            if (entry && !entry->block.empty() && entry->stamp.size == stamp.size && entry->stamp.hash == stamp.hash) {
+                datasizes[index] = entry->datasize;
+                block.assign(entry->block);
+                reused++;
+                return true;
+            }
+            encode(index, spvdata.value(), block);
+            return true;
+        }, std::move(costs));
+    pool.ForEachInOrder([&](const std::size_t index, const std::string_view block) {
+        consume(index, block);
+        ModuleState::WriteEntry(statewriter, Utf8PathString(spvfiles[index].path.filename()),
+                                stamps[index], datasizes[index], block);
+    });
+    peakheldbytes = pool.GetPeakHeldBytes();
+
+    previous.Close();
+    statewriter.Close();
+    std::filesystem::rename(TempPathFor(statepath), statepath);
+    return reused.load();
+}
+
+// Gives false when module can't be made, old module is kept then
+[[nodiscard]] bool createModuleFromSpvFiles(const ModuleOptions& options) {
+    const std::filesystem::path basepath{ std::filesystem::current_path() };
+#if defined(_MSC_VER)
+    const std::wstring writefilename = options.save_module_path.has_value() ?
+        options.save_module_path.value().wstring() + L"shader_spv.ixx" : L"shader_spv.ixx";
+    const std::wstring objectname = options.format == ArrayFormat::assembly ? L"shader_spv.S" : L"shader_spv.o";
+    const std::wstring objectfilename = options.save_module_path.has_value() ?
+        options.save_module_path.value().wstring() + objectname : objectname;
+#else
+    const std::string writefilename = options.save_module_path.has_value() ?
+        options.save_module_path.value().string() + "shader_spv.ixx" : "shader_spv.ixx";
+    const std::string objectname = options.format == ArrayFormat::assembly ? "shader_spv.S" : "shader_spv.o";
+    const std::string objectfilename = options.save_module_path.has_value() ?
+        options.save_module_path.value().string() + objectname : objectname;
+#endif
+    // In header mode module is replaced by header and source files with definitions
+    const std::filesystem::path modulepath = options.header ?
+        std::filesystem::path(writefilename).replace_extension(".hpp") : std::filesystem::path(writefilename);
+    const std::filesystem::path objectpath{ objectfilename };
+    // Shards are source files of header mode or partitions of module
+    const std::string_view shardprefix = options.header ? "shader_spv_" : "shader_spv-shard_";
+    const std::string_view shardextension = options.header ? ".cpp" : ".ixx";
+    const auto numberedshardpath = [&](const std::size_t shard) {
+        return std::filesystem::path(modulepath).replace_filename(std::string(shardprefix) + std::to_string(shard) +
+                                                                  std::string(shardextension));
+    };
+    // Header mode with one source file has it without number
+    const bool singlesource = options.header && options.shards == 1 && !options.shard_bytes.has_value();
+    const auto shardpath = [&](const std::size_t shard) {
+        return singlesource ? std::filesystem::path(modulepath).replace_filename("shader_spv.cpp") :
+            numberedshardpath(shard);
+    };
+    std::vector<std::filesystem::path> shardpaths;
+    std::filesystem::path statepath{ modulepath };
+    statepath += ".state";
+    std::string stateformat = std::string(ArrayFormatName(options.format)) +
+        (options.strip.has_value() ? " strip " + StripOptionsName(options.strip.value()) : "");
+    // Blocks of embed and asm formats have paths of files, their form depends on -reproducible and directories
+    if (options.format == ArrayFormat::embed || options.format == ArrayFormat::assembly) {
+        stateformat += (options.reproducible ? " reproducible" : "") + std::string(" base ") +
+            Utf8PathString(basepath) + " module " + Utf8PathString(std::filesystem::absolute(modulepath).parent_path());
+    }
+
+    try {
+        const std::vector<SpvInput> spvfiles = ListSpvInputs(basepath, options.reproducible);
+        const unsigned usedjobs = std::max(static_cast<unsigned>(
+            std::min<std::size_t>(options.jobs, spvfiles.size())), 1u);
+        // Half-written file of interrupted GLSLC would be embedded and crash driver later
+        ValidateSpvFiles(spvfiles, usedjobs);
+        // Source files of header mode get shaders by size, so they take about the same time to compile
+        std::vector<std::uintmax_t> sizes(spvfiles.size(), 0);
+        const bool sizesneeded = options.header || options.shard_bytes.has_value();
+        for (std::size_t i = 0; sizesneeded && i < spvfiles.size(); i++) {
+            std::error_code ec;
+            sizes[i] = std::filesystem::file_size(spvfiles[i].path, ec);
+        }
+        std::vector<std::size_t> shards;
+        std::size_t shardcount{ 0 };
+        if (options.shard_bytes.has_value()) {
+            std::vector<std::uintmax_t> blocksizes(sizes.size());
+            std::transform(sizes.begin(), sizes.end(), blocksizes.begin(),
+                           [&options](const std::uintmax_t size) { return EstimatedBlockSize(options.format, size); });
+            shards = PackShards(spvfiles, blocksizes, options.shard_bytes.value());
+            shardcount = spvfiles.empty() ? 0 : shards.back() + 1;
+        }
+        else if (options.header) {
+            shardcount = options.shards;
+            shards = AssignShards(sizes, shardcount);
+        }
+        for (std::size_t i = 0; i < shardcount; i++) {
+            shardpaths.emplace_back(shardpath(i));
+        }
+
+        // Shader with the same data as earlier shader is written as alias of it
+        std::vector<std::size_t> originals(spvfiles.size());
+        std::iota(originals.begin(), originals.end(), std::size_t{ 0 });
+        if (options.dedup.has_value()) {
+            originals = FindDuplicateShaders(spvfiles, usedjobs, options.dedup.value());
+            std::size_t duplicates{ 0 };
+            std::uintmax_t duplicatebytes{ 0 };
+            for (std::size_t i = 0; i < spvfiles.size(); i++) {
+                if (originals[i] != i) {
+                    std::error_code ec;
+                    const std::uintmax_t size = std::filesystem::file_size(spvfiles[i].path, ec);
+                    spdlog::info("Shader {0} is the same as {1} and is written as its alias", spvfiles[i].name,
+                                 spvfiles[originals[i]].name);
+                    duplicates++;
+                    duplicatebytes += ec ? 0 : size;
+                }
+            }
+            spdlog::info("Deduplication: {0} of {1} shaders are aliases, {2} bytes of their files are not written",
+                         duplicates, spvfiles.size(), duplicatebytes);
+        }
+
+        ModuleWriter writer(TempPathFor(modulepath));
+        if (options.header) {
+            writer.Write(HeaderPreamble(options.format));
+        }
+        else if (options.partitions) {
+            writer.Write(ModulePreamble(options.format));
+        }
+        else {
+            writer.Write(ModulePreamble(options.format));
+            for (std::size_t i = 0; i < shardcount; i++) {
+                writer.Write("export import :shard_" + std::to_string(i) + (i + 1 < shardcount ? ";\n" : ";\n\n"));
+            }
+            writer.Write(CommonDefinitions(options.format, true));
+        }
+
+        const HexEncoder encoder;
+        spdlog::info("Hex encoder uses {0} kernel, {1} jobs",
+                     encoder.IsSimdUsed() ? "SSSE3" : "table", usedjobs);
+
+        const BlockLinkage linkage = options.header ? BlockLinkage::source : BlockLinkage::module;
+        // Big shaders of bytes arrays (string format writes them so too) and of elf objects aren't made on pool:
+        // consumer reads them and encodes straight into output chunk, so memory doesn't grow with their size.
+        // Other formats, -strip, -partitions and -incremental need whole block of every shader, pool keeps
+        // blocks of about bytes_budget then
+        constexpr std::uintmax_t streamed_shader_size = ModuleWriter::chunk_size;
+        const bool streamable = !options.incremental && !options.partitions && !options.strip.has_value() &&
+            (options.format == ArrayFormat::bytes || options.format == ArrayFormat::string ||
+             options.format == ArrayFormat::elf);
+        std::vector<bool> streamed(spvfiles.size(), false);
+        std::vector<std::uintmax_t> costs(spvfiles.size(), 0);
+        std::size_t wholeblocks{ 0 };
+        for (std::size_t i = 0; i < spvfiles.size(); i++) {
+            std::error_code ec;
+            const std::uintmax_t size = std::filesystem::file_size(spvfiles[i].path, ec);
+            if (ec || originals[i] != i) {
+                continue;
+            }
+            streamed[i] = streamable && size >= streamed_shader_size;
+            costs[i] = streamed[i] ? 0 : EstimatedBlockSize(options.format, size);
+            if (!streamed[i] && size >= streamed_shader_size) {
+                wholeblocks++;
+            }
+        }
+        if (wholeblocks > 0) {
+            spdlog::info("{0} shaders of {1} bytes and more are encoded to whole blocks in memory, only bytes, string"
+                         " and elf formats without -strip, -partitions and -incremental write them without blocks",
+                         wholeblocks, streamed_shader_size);
+        }
+        std::size_t peakheldbytes{ 0 };
+        // Sizes of shader data in blocks, they are smaller than files when debug info is stripped
+        std::vector<std::uintmax_t> datasizes(spvfiles.size(), 0);
+        std::atomic<std::uintmax_t> strippedbytes{ 0 };
+        std::atomic<std::uintmax_t> compressedinput{ 0 };
+        std::atomic<std::uintmax_t> compressedoutput{ 0 };
+        const ShaderBlockEncoder encode = [&](const std::size_t index, std::span<const std::byte> spvdata,
+                                              std::string& block) {
+            // Duplicate gets alias when it is consumed
+            if (originals[index] != index) {
+                return;
+            }
+            std::vector<std::byte> stripped;
+            if (options.strip.has_value()) {
+                if (StripSpvModule(spvdata, options.strip.value(), stripped)) {
+                    spdlog::info("Shader {0}: {1} of {2} bytes are stripped", spvfiles[index].name,
+                                 spvdata.size() - stripped.size(), spvdata.size());
+                    strippedbytes += spvdata.size() - stripped.size();
+                    spvdata = stripped;
+                }
+                else {
+                    spdlog::warn("Shader {0} is not valid SPIRV module and is not stripped", spvfiles[index].name);
+                }
+            }
+            datasizes[index] = spvdata.size();
+            // Shaders are compressed on threads of pool
+            if (options.format == ArrayFormat::compact || options.format == ArrayFormat::lz4) {
+                const std::vector<std::byte> compressed = options.format == ArrayFormat::compact ?
+                    CompactSpvModule(spvdata, spvfiles[index].name) : CompressLzShader(spvdata);
+                compressedinput += spvdata.size();
+                compressedoutput += compressed.size();
+                CompressedShaderBlock(encoder, options.format, linkage, spvfiles[index].name, spvdata.size(),
+                                      compressed, block);
+                return;
+            }
+            if (options.format == ArrayFormat::embed) {
+                EmbedShaderBlock(linkage, spvfiles[index].name, options.reproducible ?
+                    spvfiles[index].path.lexically_relative(std::filesystem::absolute(modulepath).parent_path()) :
+                    spvfiles[index].path, spvdata, block);
+                return;
+            }
+            // Reproducible path is relative to directory of assembler file as #embed path is relative to module.
+            // Assembler looks for .incbin only in include directories, so this directory is passed to it with -I
+            if (options.format == ArrayFormat::assembly) {
+                AssemblyShaderBlock(spvfiles[index].name, options.reproducible ?
+                    spvfiles[index].path.lexically_relative(std::filesystem::absolute(objectpath).parent_path()) :
+                    spvfiles[index].path, spvdata, block);
+                return;
+            }
+            EncodeShaderBlock(encoder, options.format, linkage, spvfiles[index].name, spvdata, block);
+        };
+
+        const std::string commondefinitions = CommonDefinitions(options.format, true);
+        // Object file formats put data to object or assembler file and only declarations to module
+        std::optional<ElfObjectWriter> object;
+        std::optional<ModuleWriter> assembly;
+        std::string declarations;
+        std::string definitions;
+        if (options.format == ArrayFormat::elf) {
+            object.emplace(TempPathFor(objectpath));
+        }
+        else if (options.format == ArrayFormat::assembly) {
+            assembly.emplace(TempPathFor(objectpath));
+            assembly->Write(assembly_preamble);
+        }
+        else if (options.partitions) {
+            if (!commondefinitions.empty()) {
+                WriteModuleIfChanged(std::filesystem::path(modulepath).replace_filename(
+                    std::string(common_module_name) + ".ixx"),
+                    ModulePreamble(options.format, common_module_name) + commondefinitions);
+                writer.Write("export import " + std::string(common_module_name) + ";\n");
+            }
+        }
+        else if (shardcount == 0) {
+            writer.Write("namespace OnyWarp\n{\n");
+            if (options.format == ArrayFormat::blob) {
+                writer.Write(BlobDefinitions());
+            }
+        }
+        std::size_t changedpartitions{ 0 };
+        std::uintmax_t bloboffset{ 0 };
+        std::vector<std::uintmax_t> bloboffsets(spvfiles.size(), 0);
+        std::string blobtable;
+        std::string blobspans;
+        // Aliases of duplicates are written after all shaders, where data of every original is visible
+        std::string aliases;
+        // Names of shaders which are written, lookup is made from them
+        std::vector<std::string_view> lookupnames;
+
+        std::deque<ModuleWriter> shardwriters;
+        for (std::size_t i = 0; i < shardcount; i++) {
+            shardwriters.emplace_back(TempPathFor(shardpaths[i]));
+            shardwriters.back().Write(options.header ?
+                "#include \"" + Utf8PathString(modulepath.filename()) + "\"\n\n#include <array>\n\n" :
+                ModulePreamble(options.format, "shader_spv:shard_" + std::to_string(i)));
+            shardwriters.back().Write("namespace OnyWarp\n{\n");
+        }
+        SpvFileReader streamreader;
+        const auto consume = [&](const std::size_t index, const std::string_view block) {
+            // Block of streamed shader is empty, its data is encoded when block is written
+            std::optional<std::span<const std::byte>> streamdata;
+            if (streamed[index]) {
+                streamdata = streamreader.Open(spvfiles[index].path);
+                if (!streamdata.has_value()) {
+                    throw std::runtime_error("Unable to read " + Utf8PathString(spvfiles[index].path));
+                }
+                datasizes[index] = streamdata->size();
+            }
+            const auto writeblock = [&](ModuleWriter& target) {
+                if (!streamdata.has_value()) {
+                    target.Write(block);
+                    return;
+                }
+                const std::string& nameofdata = spvfiles[index].name;
+                target.Write(HexArrayHeader(options.format, linkage, nameofdata, streamdata->size()));
+                target.WriteEncoded(encoder, streamdata.value());
+                target.Write(ShaderArrayFooter(options.format, linkage, nameofdata, streamdata->size()));
+            };
+            lookupnames.push_back(spvfiles[index].name);
+            const std::size_t original = originals[index];
+            if (original != index) {
+                datasizes[index] = datasizes[original];
+            }
+            if (object.has_value() || assembly.has_value()) {
+                const std::string& nameofdata = spvfiles[index].name;
+                // Duplicate uses symbol of original
+                const std::string symbol = "shader_spv_" + spvfiles[original].name + "_bytecode";
+                std::string size;
+                if (object.has_value()) {
+                    size = std::to_string(datasizes[index]);
+                    if (original == index) {
+                        object->Add(symbol, streamdata.has_value() ? std::string_view(
+                            reinterpret_cast<const char*>(streamdata->data()), streamdata->size()) : block);
+                    }
+                }
+                else {
+                    size = std::to_string(std::filesystem::file_size(spvfiles[original].path));
+                    assembly->Write(block);
+                }
+                if (original == index) {
+                    declarations += "\textern const unsigned char " + symbol + "[];\n";
+                    declarations += "\textern const std::size_t " + symbol + "_size;\n";
+                }
+                definitions += "\texport inline constexpr std::span<const unsigned char, " + size + "> " +
+                    nameofdata + "_bytecode{ " + symbol + ", " + size + " };\n";
+            }
+            else if (options.partitions) {
+                // Every shader is own module, so importers of one shader don't depend on others
+                const std::string partitionname = "shader_spv." + spvfiles[index].name;
+                std::string text = ModulePreamble(options.format, partitionname);
+                if (!commondefinitions.empty()) {
+                    text += "export import " + std::string(common_module_name) + ";\n";
+                }
+                // Module of duplicate imports module of original and refers to its data
+                if (original != index) {
+                    text += "export import shader_spv." + spvfiles[original].name + ";\n";
+                }
+                text += commondefinitions.empty() && original == index ? "namespace OnyWarp\n{\n" :
+                    "\nnamespace OnyWarp\n{\n";
+                if (original != index) {
+                    AliasShaderBlock(options.format, spvfiles[index].name, spvfiles[original].name, datasizes[index],
+                                     text);
+                }
+                else {
+                    text += block;
+                }
+                text += "}";
+                if (WriteModuleIfChanged(std::filesystem::path(modulepath).replace_filename(partitionname + ".ixx"),
+                                         text)) {
+                    changedpartitions++;
+                }
+                writer.Write("export import " + partitionname + ";\n");
+            }
+            else if (options.format == ArrayFormat::blob) {
+                const std::string& nameofdata = spvfiles[index].name;
+                const std::string offset = std::to_string(original == index ? bloboffset : bloboffsets[original]);
+                const std::string words = std::to_string(datasizes[index] / sizeof(std::uint32_t));
+                bloboffsets[index] = bloboffset;
+                blobtable += "\t\t{ \"" + nameofdata + "\", " + offset + ", " + words + ", ShaderStage::" +
+                    std::string(ShaderStageName(spvfiles[index].path)) + " },\n";
+                blobspans += "\texport inline constexpr std::span<const std::uint32_t, " + words + "> " + nameofdata +
+                    "_bytecode{ shader_blob + " + offset + ", " + words + " };\n";
+                if (original == index) {
+                    writer.Write(block);
+                    bloboffset += datasizes[index] / sizeof(std::uint32_t);
+                }
+            }
+            else if (options.header) {
+                if (original != index) {
+                    writer.Write(HeaderDeclaration(options.format, spvfiles[index].name, datasizes[index],
+                                                   spvfiles[original].name));
+                    return;
+                }
+                writer.Write(HeaderDeclaration(options.format, spvfiles[index].name, datasizes[index]));
+                writeblock(shardwriters[shards[index]]);
+            }
+            else if (original != index) {
+                AliasShaderBlock(options.format, spvfiles[index].name, spvfiles[original].name, datasizes[index],
+                                 aliases);
+            }
+            else if (shardcount > 0) {
+                writeblock(shardwriters[shards[index]]);
+            }
+            else {
+                writeblock(writer);
+            }
+        };
+
+        if (options.incremental) {
+            const std::size_t reused = ProduceBlocksIncremental(spvfiles, usedjobs, statepath, stateformat,
+                                                                datasizes, encode, consume, costs, peakheldbytes);
+            spdlog::info("Incremental mode: {0} of {1} shaders reused", reused, spvfiles.size());
+        }
+        else if (usedjobs > 1 || options.format != ArrayFormat::bytes || options.partitions || shardcount > 0 ||
+                 options.strip.has_value() || options.dedup.has_value()) {
+            ShaderEncodePool pool(spvfiles.size(), usedjobs,
+                [&](const std::size_t index, SpvFileReader& reader, std::string& block) {
+                    if (streamed[index]) {
+                        return true;
+                    }
+                    const std::optional<std::span<const std::byte>> spvdata = reader.Open(spvfiles[index].path);
+                    if (!spvdata.has_value()) {
+                        return false;
+                    }
+                    encode(index, spvdata.value(), block);
+                    return true;
+                }, costs);
+            pool.ForEachInOrder(consume);
+            peakheldbytes = pool.GetPeakHeldBytes();
+        }
+        else {
+            SpvFileReader reader;
+            for (auto const& input : spvfiles) {
+                const std::optional<std::span<const std::byte>> spvdata = reader.Open(input.path);
+                if (!spvdata.has_value()) {
+                    continue;
+                }
+                lookupnames.push_back(input.name);
+                writer.Write(ShaderArrayHeader(input.name, spvdata->size()));
+                writer.WriteEncoded(encoder, spvdata.value());
+                writer.Write(shader_array_footer);
+            }
+        }
+
+        if (object.has_value() || assembly.has_value()) {
+            if (object.has_value()) {
+                object->Close();
+                spdlog::info("Object size {0} bytes", object->GetWrittenSize());
+            }
+            else {
+                assembly->Write(assembly_footer);
+                assembly->Close();
+            }
+            if (!ReplaceFileIfChanged(TempPathFor(objectpath), objectpath)) {
+                spdlog::info("Object is not changed, existing file is kept");
+            }
+            writer.Write("extern \"C\"\n{\n" + declarations + "}\n\nnamespace OnyWarp\n{\n" + definitions);
+        }
+        if (options.format == ArrayFormat::blob) {
+            // Array of unknown bound can't be empty
+            writer.Write(bloboffset == 0 ? "\t\t0\n\t};\n\n" : "\t};\n\n");
+            writer.Write("\texport inline constexpr std::array<ShaderBlobEntry, " +
+                         std::to_string(std::count(blobtable.begin(), blobtable.end(), '\n')) +
+                         "> shader_blob_table\n\t{ {\n" + blobtable + "\t} };\n\n");
+            writer.Write("\texport constexpr std::span<const std::uint32_t> ShaderWords(const ShaderBlobEntry& entry) noexcept\n"
+                         "\t{\n\t\treturn { shader_blob + entry.offset, entry.size };\n\t}\n\n");
+            writer.Write(blobspans);
+        }
+        // Module of partitions or shards doesn't open own namespace
+        const bool namespaceopen = options.header || (shardcount == 0 && !options.partitions);
+        writer.Write((namespaceopen ? "\n" : "\nnamespace OnyWarp\n{\n") + aliases +
+                     (aliases.empty() ? "" : "\n") + ShaderLookup(options.format, linkage, lookupnames) +
+                     (namespaceopen ? "" : "}"));
+        if (options.strip.has_value()) {
+            spdlog::info("Stripping removed {0} bytes of encoded shaders", strippedbytes.load());
+        }
+        if (options.format == ArrayFormat::compact || options.format == ArrayFormat::lz4) {
+            spdlog::info("{0} format: {1} bytes of encoded shaders are compressed to {2} bytes",
+                         ArrayFormatName(options.format), compressedinput.load(), compressedoutput.load());
+        }
+        if (options.partitions) {
+            spdlog::info("{0} of {1} shader modules are changed", changedpartitions, spvfiles.size());
+        }
+        else if (options.header || shardcount == 0) {
+            writer.Write("}");
+        }
+        for (std::size_t i = 0; i < shardcount; i++) {
+            shardwriters[i].Write("}");
+            shardwriters[i].Close();
+            spdlog::info("Shard {0} size {1} bytes", Utf8PathString(shardpaths[i].filename()),
+                         shardwriters[i].GetWrittenSize());
+            if (!ReplaceFileIfChanged(TempPathFor(shardpaths[i]), shardpaths[i])) {
+                spdlog::info("Shard is not changed, existing file is kept");
+            }
+        }
+        // Shards left from previous run with more shards, other naming or without shards are removed, so build
+        // which compiles all files of directory doesn't get them. Header mode and module mode remove only own files
+        const std::filesystem::path moduledirectory = std::filesystem::absolute(modulepath).parent_path();
+        std::unordered_set<std::string> keptshards;
+        for (const std::filesystem::path& path : shardpaths) {
+            keptshards.insert(Utf8PathString(path.filename()));
+        }
+        RemoveStaleFiles(moduledirectory, shardprefix, shardextension, keptshards, true);
+        std::error_code ec;
+        const std::filesystem::path singlepath = moduledirectory / "shader_spv.cpp";
+        if (options.header && !singlesource && std::filesystem::remove(singlepath, ec)) {
+            spdlog::info("Stale file {0} is removed", Utf8PathString(singlepath.filename()));
+        }
+        // Modules of shaders which are removed or written without -partitions would still be compiled
+        if (!options.header) {
+            std::unordered_set<std::string> keptmodules;
+            if (options.partitions) {
+                for (const SpvInput& input : spvfiles) {
+                    keptmodules.insert("shader_spv." + input.name + ".ixx");
+                }
+            }
+            RemoveStaleFiles(moduledirectory, "shader_spv.", ".ixx", keptmodules);
+            const std::filesystem::path commonpath = moduledirectory / (std::string(common_module_name) + ".ixx");
+            if ((!options.partitions || commondefinitions.empty()) && std::filesystem::remove(commonpath, ec)) {
+                spdlog::info("Stale file {0} is removed", Utf8PathString(commonpath.filename()));
+            }
+        }
+        writer.Close();
+        std::size_t peakbufferbytes = writer.GetPeakBufferUsage() +
+            (object.has_value() ? object->GetPeakBufferUsage() : 0) +
+            (assembly.has_value() ? assembly->GetPeakBufferUsage() : 0);
+        for (const ModuleWriter& shardwriter : shardwriters) {
+            peakbufferbytes += shardwriter.GetPeakBufferUsage();
+        }
+        spdlog::info("Module size {0} bytes, peak buffer usage {1} bytes: {2} bytes of output buffers and {3} bytes"
+                     " of encoded shader blocks", writer.GetWrittenSize(), peakbufferbytes + peakheldbytes,
+                     peakbufferbytes, peakheldbytes);
+        if (!ReplaceFileIfChanged(TempPathFor(modulepath), modulepath)) {
+            spdlog::info("Module is not changed, existing file is kept");
+        }
+        if (options.depfile_path.has_value()) {
+            WriteDepfile(options.depfile_path.value(), modulepath, spvfiles, options.reproducible);
+        }
+    }
+    catch (const std::runtime_error& ex) {
+        spdlog::critical("Unable to write ixx file: {0}", ex.what());
+        std::error_code ec;
+        std::filesystem::remove(TempPathFor(modulepath), ec);
+        std::filesystem::remove(TempPathFor(objectpath), ec);
+        std::filesystem::remove(TempPathFor(statepath), ec);
+        for (const std::filesystem::path& path : shardpaths) {
+            std::filesystem::remove(TempPathFor(path), ec);
+        }
+        return false;
     }
-    const std::string finalstr = finalbuf.str();
-    ostrm.write(finalstr.c_str(), finalstr.size());
     spdlog::info("All done");
+    return true;
 }
 
 int main(int argc, char* argv[]) {
     std::optional<bool> iscompileall;
     std::optional<std::deque<PARSESTR>> tocompilelist;
+    ModuleOptions moduleoptions{ .jobs = std::max(std::thread::hardware_concurrency(), 1u) };
    
+    std::optional<CommandLineParser<PARSESTR>> commandparser;
     if (argc > 1) {
         try {
-            CommandLineParser<PARSESTR> parser(argc, const_cast<const char**>(argv));           
-            iscompileall = parser.GetIsCompileAll();
-            tocompilelist = parser.GetToCompileList();
+            commandparser.emplace(argc, const_cast<const char**>(argv));
+            iscompileall = commandparser->GetIsCompileAll();
+            tocompilelist = commandparser->GetToCompileList();
             if (iscompileall.has_value() and tocompilelist.has_value()) {
                 throw std::runtime_error("compile_all and compile_files can't"
                                                             " be set simultaneously");
@@ -508,39 +4286,134 @@ int main(int argc, char* argv[]) {
         catch (const std::runtime_error& ex) {
             spdlog::warn("Command line parse problem: {0}. Programm will"
                         " not compile shaders, only create module", ex.what());
+            commandparser.reset();
             iscompileall.reset();
             tocompilelist.reset();
         }
     }
+    // Wrong or conflicting option values stop program, module made with part of options would be wrong
+    if (commandparser.has_value()) {
+        try {
+            moduleoptions.incremental = commandparser->GetIsIncremental().has_value();
+            moduleoptions.reproducible = commandparser->GetIsReproducible().has_value();
+            if (const std::optional<std::deque<PARSESTR>> jobslist = commandparser->GetJobs()) {
+                moduleoptions.jobs = static_cast<unsigned>(std::min<unsigned long long>(
+                    ParseCountArgument(jobslist.value(), "-jobs"), 1024));
+            }
+            if (const std::optional<std::deque<PARSESTR>> depfile = commandparser->GetDepfile()) {
+                if (depfile->size() != 1) {
+                    throw std::runtime_error("-MF must have one path");
+                }
+                moduleoptions.depfile_path = depfile->front();
+            }
+            if (const std::optional<std::deque<PARSESTR>> format = commandparser->GetFormat()) {
+                moduleoptions.format = ParseArrayFormat(format.value());
+            }
+            if (commandparser->GetIsPartitions().has_value()) {
+                if (IsSingleFileFormat(moduleoptions.format)) {
+                    throw std::runtime_error("-partitions can't be used with elf, asm and blob formats");
+                }
+                moduleoptions.partitions = true;
+            }
+            if (commandparser->GetIsHeader().has_value()) {
+                if (IsSingleFileFormat(moduleoptions.format) || moduleoptions.partitions) {
+                    throw std::runtime_error("-header can't be used with elf, asm and blob formats and -partitions");
+                }
+                moduleoptions.header = true;
+            }
+            if (const std::optional<std::deque<PARSESTR>> shards = commandparser->GetShards()) {
+                if (!moduleoptions.header) {
+                    throw std::runtime_error("-shards needs -header");
+                }
+                moduleoptions.shards = static_cast<std::size_t>(std::min<unsigned long long>(
+                    ParseCountArgument(shards.value(), "-shards"), 1024));
+            }
+            if (const std::optional<std::deque<PARSESTR>> shardbytes = commandparser->GetShardBytes()) {
+                if (shardbytes->size() != 1) {
+                    throw std::runtime_error("-shard_bytes must have one size");
+                }
+                if (IsSingleFileFormat(moduleoptions.format) || moduleoptions.partitions ||
+                    commandparser->GetShards().has_value()) {
+                    throw std::runtime_error("-shard_bytes can't be used with elf, asm and blob formats,"
+                                             " -partitions and -shards");
+                }
+                moduleoptions.shard_bytes = ParseByteSize(shardbytes->front(), "-shard_bytes");
+            }
+            if (const std::optional<std::deque<PARSESTR>> strip = commandparser->GetStrip()) {
+                // These formats take shader data from files at build time
+                if (moduleoptions.format == ArrayFormat::embed || moduleoptions.format == ArrayFormat::assembly) {
+                    throw std::runtime_error("-strip can't be used with embed and asm formats");
+                }
+                moduleoptions.strip = ParseStripOptions(strip.value());
+            }
+            if (const std::optional<std::deque<PARSESTR>> dedup = commandparser->GetDedup()) {
+                moduleoptions.dedup = ParseDedupMode(dedup.value());
+            }
+        }
+        catch (const std::runtime_error& ex) {
+            spdlog::critical("Wrong command line option: {0}", ex.what());
+            return EXIT_FAILURE;
+        }
+    }
 
     std::optional<std::filesystem::path> glslc_path;
     std::optional<std::filesystem::path> save_module_path;
+    std::optional<std::filesystem::path> cache_path;
+    std::uintmax_t cache_max_size{ ShaderCompileCache::default_max_size };
+    std::optional<std::filesystem::path> cxx_path;
     try {
         ConfigParser parser;
         glslc_path = parser.GetGlslcPath();
         save_module_path = parser.GetSaveModulePath();
+        cache_path = parser.GetCachePath();
+        if (const std::optional<std::filesystem::path> maxsize = parser.GetCacheMaxSize()) {
+            cache_max_size = ParseByteSize(maxsize.value().string(), "cache_max_size");
+        }
+        cxx_path = parser.GetCxxPath();
     }
     catch (const std::ios_base::failure& ex) {
         spdlog::warn("Exception opening/reading/closing configuration"
                         " file: {0}. Program will use default parameters", ex.what());
         glslc_path.reset();
         save_module_path.reset();
+        cache_path.reset();
+        cxx_path.reset();
     }
     catch (const std::runtime_error& ex) {
         spdlog::warn("Unable to parse configuration file: {0}."
                         " Program will use default parameters", ex.what());
         glslc_path.reset();
         save_module_path.reset();
+        cache_path.reset();
+        cxx_path.reset();
+    }
+
+    // Without compiler to probe #embed is trusted to be supported
+    if (moduleoptions.format == ArrayFormat::embed && cxx_path.has_value() && !IsEmbedSupported(cxx_path.value())) {
+        spdlog::warn("{0} doesn't support #embed, bytes format is used", cxx_path->string());
+        moduleoptions.format = ArrayFormat::bytes;
+    }
+
+    std::optional<ShaderCompileCache> compilecache;
+    if (cache_path.has_value()) {
+        try {
+            compilecache.emplace(cache_path.value(), cache_max_size);
+        }
+        catch (const std::filesystem::filesystem_error& ex) {
+            spdlog::warn("Unable to use compile cache: {0}. Shaders will be compiled", ex.what());
+        }
     }
     
     bool glslresult{ true };
     if (iscompileall.has_value() or tocompilelist.has_value()) {
-        glslresult = RunGlslcProcess(glslc_path, iscompileall, tocompilelist);
+        glslresult = RunGlslcProcess(glslc_path, iscompileall, tocompilelist, moduleoptions.jobs,
+                                     moduleoptions.depfile_path.has_value(), compilecache);
     }
-    if (glslresult) {
-        createModuleFromSpvFiles(save_module_path);
-    }
-    else {
+    if (!glslresult) {
         spdlog::warn("All done without creating module file");
+        return EXIT_FAILURE;
     }
+    moduleoptions.save_module_path = save_module_path;
+    // Build system must see failure, old module isn't valid for changed shaders
+    return createModuleFromSpvFiles(moduleoptions) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#!/usr/bin/env python3
+"""Compares consumer compile time and compiler peak memory of bytes and embed module formats.
+
+Module is turned into plain translation unit (module declarations are removed), so any
+compiler can build it without module support. Peak memory is measured on POSIX only.
+
+Usage: embed_benchmark.py <spv2headerconv> <directory with .spv files> [C++ compiler]
+"""
+
+import os
+import pathlib
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def make_translation_unit(module_text):
+    text = re.sub(r"^export module .*$", "", module_text, flags=re.M)
+    text = re.sub(r"^import <(.*)>;$", r"#include <\1>", text, flags=re.M)
+    return re.sub(r"\bexport ", "", text)
+
+
+def compile_measured(compiler, source, output):
+    command = [compiler, "-std=c++20", "-c", str(source), "-o", str(output)]
+    start = time.perf_counter()
+    process = subprocess.Popen(command)
+    if hasattr(os, "wait4"):
+        _, status, usage = os.wait4(process.pid, 0)
+        process.returncode = os.waitstatus_to_exitcode(status)
+        peak = usage.ru_maxrss * (1 if sys.platform == "darwin" else 1024)
+    else:
+        process.wait()
+        peak = None
+    elapsed = time.perf_counter() - start
+    if process.returncode != 0:
+        return None
+    return elapsed, peak
+
+
+def main():
+    if len(sys.argv) < 3:
+        print(__doc__)
+        return 1
+    converter = pathlib.Path(sys.argv[1]).resolve()
+    spvdir = pathlib.Path(sys.argv[2]).resolve()
+    compiler = sys.argv[3] if len(sys.argv) > 3 else os.environ.get("CXX", "c++")
+
+    with tempfile.TemporaryDirectory() as workdir:
+        work = pathlib.Path(workdir)
+        total = 0
+        for spv in spvdir.glob("*.spv"):
+            shutil.copy(spv, work)
+            total += spv.stat().st_size
+        print(f"{total} bytes of SPIRV, compiler {compiler}")
+
+        for format in ("bytes", "embed"):
+            subprocess.run([str(converter), "-format", format], cwd=work, check=True,
+                           stdout=subprocess.DEVNULL)
+            module = work / "shader_spv.ixx"
+            source = work / f"shader_spv_{format}.cpp"
+            source.write_text(make_translation_unit(module.read_text(encoding="utf-8")), encoding="utf-8")
+            result = compile_measured(compiler, source, work / f"shader_spv_{format}.o")
+            if result is None:
+                print(f"{format:>6}: compilation failed")
+                continue
+            elapsed, peak = result
+            peaktext = f"{peak / (1024 * 1024):.1f} MiB" if peak is not None else "n/a"
+            print(f"{format:>6}: {source.stat().st_size} bytes of source, "
+                  f"{elapsed:.2f} s, peak RSS {peaktext}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,55 @@
+# spv2headerconv_add_shader_object(<target> SHADER_DIR <dir> [FORMAT asm|elf] [REPRODUCIBLE]
+#                                  [MODULE_VARIABLE <variable>])
+#
+# Runs spv2headerconv with "-format asm" (default) or "-format elf" in directory of SPIRV files when any of them
+# is changed, and adds "shader_spv.S" or "shader_spv.o" made there to sources of target, so shaders are assembled
+# or linked instead of being compiled by C++ frontend. Path of module "shader_spv.ixx" which declares them is
+# written to MODULE_VARIABLE, it is added to module sources of target by caller. Assembler gets directory of
+# "shader_spv.S" as include directory, so ".incbin" finds shaders also with REPRODUCIBLE (relative paths).
+# Converter must write files to directory of shaders ("save_module_path" isn't set in its configuration file),
+# "asm" format needs enable_language(ASM) and both formats need GCC or Clang. Call it in directory of target
+function(spv2headerconv_add_shader_object target)
+    cmake_parse_arguments(PARSE_ARGV 1 SPV "REPRODUCIBLE" "SHADER_DIR;FORMAT;MODULE_VARIABLE" "")
+    if(NOT SPV_SHADER_DIR)
+        message(FATAL_ERROR "spv2headerconv_add_shader_object: SHADER_DIR is not set")
+    endif()
+    if(NOT SPV_FORMAT)
+        set(SPV_FORMAT asm)
+    endif()
+    if(SPV_FORMAT STREQUAL "asm")
+        get_property(languages GLOBAL PROPERTY ENABLED_LANGUAGES)
+        if(NOT "ASM" IN_LIST languages)
+            message(FATAL_ERROR "spv2headerconv_add_shader_object: asm format needs enable_language(ASM)")
+        endif()
+        set(objectname shader_spv.S)
+    elseif(SPV_FORMAT STREQUAL "elf")
+        set(objectname shader_spv.o)
+    else()
+        message(FATAL_ERROR "spv2headerconv_add_shader_object: FORMAT must be asm or elf")
+    endif()
+
+    get_filename_component(shaderdir "${SPV_SHADER_DIR}" ABSOLUTE)
+    file(GLOB spvfiles CONFIGURE_DEPENDS "${shaderdir}/*.spv")
+    set(options -format ${SPV_FORMAT})
+    if(SPV_REPRODUCIBLE)
+        list(APPEND options -reproducible)
+    endif()
+    add_custom_command(OUTPUT "${shaderdir}/${objectname}" "${shaderdir}/shader_spv.ixx"
+        COMMAND spv2headerconv ${options}
+        WORKING_DIRECTORY "${shaderdir}"
+        DEPENDS spv2headerconv ${spvfiles}
+        COMMENT "Making ${objectname} from SPIRV files of ${shaderdir}"
+        VERBATIM)
+
+    if(SPV_FORMAT STREQUAL "asm")
+        set_source_files_properties("${shaderdir}/${objectname}" PROPERTIES
+            GENERATED TRUE COMPILE_OPTIONS "-Wa,-I${shaderdir}")
+    else()
+        set_source_files_properties("${shaderdir}/${objectname}" PROPERTIES
+            GENERATED TRUE EXTERNAL_OBJECT TRUE)
+    endif()
+    target_sources(${target} PRIVATE "${shaderdir}/${objectname}")
+    if(SPV_MODULE_VARIABLE)
+        set(${SPV_MODULE_VARIABLE} "${shaderdir}/shader_spv.ixx" PARENT_SCOPE)
+    endif()
+endfunction()